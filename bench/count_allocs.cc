@@ -0,0 +1,18 @@
+// Counts the heap allocations of a program, for edit --stats:
+//   LD_PRELOAD=lib/count_allocs.so edit --stats ...
+
+#include <cstdlib>
+#include <atomic>
+#include <new>
+
+extern "C" {
+std::atomic<size_t> expunc_nallocs { 0 };
+}
+
+void* operator new(size_t n) {
+  expunc_nallocs.fetch_add(1,std::memory_order_relaxed);
+  if (void* p = std::malloc(n ? n : 1)) return p;
+  throw std::bad_alloc();
+}
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete(void* p, size_t) noexcept { std::free(p); }
@@ -0,0 +1,89 @@
+// Times ivanp::stod and ivanp::dtos against the conversions they replaced,
+// boost::lexical_cast and std::stringstream, on the cells of a data file.
+//   bench_numconv [file.dat [repetitions]]
+// The file defaults to data/uncert.dat, made by make in data/.
+
+#include <iostream>
+#include <fstream>
+#include <iomanip>
+#include <vector>
+#include <string>
+#include <chrono>
+#include <cstdlib>
+
+#include <boost/lexical_cast.hpp>
+
+#include "numconv.hh"
+#include "string.hh"
+
+using std::cout;
+using std::cerr;
+using std::endl;
+
+template <typename F>
+double timed(F&& f) {
+  const auto start = std::chrono::steady_clock::now();
+  f();
+  return std::chrono::duration<double,std::milli>(
+    std::chrono::steady_clock::now() - start).count();
+}
+
+int main(int argc, char* argv[]) {
+  const char* fname = argc > 1 ? argv[1] : "data/uncert.dat";
+  const unsigned nrep = argc > 2 ? std::strtoul(argv[2],nullptr,10) : 100;
+
+  // every number after the colon, halves of asymmetric cells separately
+  std::ifstream f(fname);
+  if (!f) {
+    cerr << "cannot open " << fname << endl;
+    return 1;
+  }
+  std::vector<std::string> cells;
+  for (std::string line; getline(f,line); ) {
+    const auto colon = line.find(':');
+    if (colon==std::string::npos) continue;
+    for (size_t i=colon+1, j; i<line.size(); i=j+1) {
+      j = line.find_first_of(" ,",i);
+      if (j==std::string::npos) j = line.size();
+      if (j!=i) cells.emplace_back(line,i,j-i);
+    }
+  }
+
+  double sum1 = 0, sum2 = 0;
+  size_t len1 = 0, len2 = 0;
+  const double parse1 = timed([&]{
+    for (unsigned r=0; r<nrep; ++r)
+      for (const auto& s : cells) {
+        try { sum1 += boost::lexical_cast<double>(s); }
+        catch (const boost::bad_lexical_cast&) { }
+      }
+  });
+  std::vector<double> xs;
+  xs.reserve(cells.size());
+  const double parse2 = timed([&]{
+    double x;
+    for (unsigned r=0; r<nrep; ++r) {
+      xs.clear();
+      for (const auto& s : cells)
+        if (ivanp::stod(s,x)) sum2 += x, xs.push_back(x);
+    }
+  });
+  const double format1 = timed([&]{
+    for (unsigned r=0; r<nrep; ++r)
+      for (double x : xs)
+        len1 += ivanp::cat(std::fixed,std::setprecision(8),x).size();
+  });
+  char buf[ivanp::dtos_size];
+  const double format2 = timed([&]{
+    for (unsigned r=0; r<nrep; ++r)
+      for (double x : xs) len2 += ivanp::dtos(x,8,buf,sizeof(buf));
+  });
+  if (sum1!=sum2 || len1!=len2) {
+    cout << "results differ" << endl;
+    return 1;
+  }
+
+  cout << fname << ": " << cells.size() << " cells x " << nrep << ", ms\n"
+       << "parse   lexical_cast " << parse1  << ", stod " << parse2  << '\n'
+       << "format  stringstream " << format1 << ", dtos " << format2 << endl;
+}
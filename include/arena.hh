@@ -0,0 +1,97 @@
+#ifndef IVANP_EXP_UNC_ARENA_HH
+#define IVANP_EXP_UNC_ARENA_HH
+
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <algorithm>
+#include <type_traits>
+#include <cstdint>
+
+// Monotonic memory for parsed data.
+// Allocations are carved out of a few large blocks,
+// which are all freed together when the arena is destroyed.
+// Containers refer to the arena through their allocator,
+// so it lives as long as any data allocated from it.
+class arena {
+  std::mutex mx;
+  char *p = nullptr, *end = nullptr;
+  size_t next_size = size_t(1) << 16;
+  std::vector<void*> blocks;
+
+public:
+  arena() = default;
+  arena(const arena&) = delete;
+  arena& operator=(const arena&) = delete;
+  ~arena() { for (void* b : blocks) ::operator delete(b); }
+
+  void* allocate(size_t n, size_t align) {
+    std::lock_guard<std::mutex> lock(mx);
+    auto* q = reinterpret_cast<char*>(
+      (reinterpret_cast<uintptr_t>(p) + align-1) & ~uintptr_t(align-1));
+    if (!p || n > size_t(end-q)) {
+      const size_t size = std::max(next_size,n+align);
+      blocks.reserve(blocks.size()+1);
+      p = static_cast<char*>(::operator new(size));
+      blocks.push_back(p);
+      end = p + size;
+      if (next_size < (size_t(1) << 26)) next_size *= 2;
+      q = reinterpret_cast<char*>(
+        (reinterpret_cast<uintptr_t>(p) + align-1) & ~uintptr_t(align-1));
+    }
+    p = q + n;
+    return q;
+  }
+
+  // arena taken by default-constructed allocators on this thread
+  static std::shared_ptr<arena>& current() {
+    static thread_local std::shared_ptr<arena> a;
+    return a;
+  }
+  // sets a new current arena, unless there already is one
+  class scope {
+    bool own;
+  public:
+    scope(): own(!current()) { if (own) current() = std::make_shared<arena>(); }
+    scope(const scope&) = delete;
+    scope& operator=(const scope&) = delete;
+    ~scope() { if (own) current().reset(); }
+  };
+};
+
+// Allocates from the arena current at construction, or the heap if none.
+// The arena follows the data when containers are moved, copied or swapped.
+template <typename T>
+class arena_allocator {
+  template <typename> friend class arena_allocator;
+  std::shared_ptr<arena> a;
+public:
+  using value_type = T;
+  using propagate_on_container_copy_assignment = std::true_type;
+  using propagate_on_container_move_assignment = std::true_type;
+  using propagate_on_container_swap = std::true_type;
+
+  arena_allocator(): a(arena::current()) { }
+  template <typename U>
+  arena_allocator(const arena_allocator<U>& o) noexcept: a(o.a) { }
+
+  T* allocate(size_t n) {
+    return a ? static_cast<T*>(a->allocate(n*sizeof(T),alignof(T)))
+             : std::allocator<T>().allocate(n);
+  }
+  void deallocate(T* p, size_t n) noexcept {
+    if (!a) std::allocator<T>().deallocate(p,n);
+  }
+
+  template <typename U>
+  bool operator==(const arena_allocator<U>& o) const noexcept
+  { return a == o.a; }
+  template <typename U>
+  bool operator!=(const arena_allocator<U>& o) const noexcept
+  { return a != o.a; }
+};
+
+template <typename T>
+using arena_vector = std::vector<T,arena_allocator<T>>;
+
+#endif
@@ -0,0 +1,31 @@
+#ifndef IVANP_EXP_UNC_BANDS_HH
+#define IVANP_EXP_UNC_BANDS_HH
+
+#include <cstddef>
+#include <vector>
+#include <string>
+
+#include "reader.hh"
+
+namespace ivanp {
+
+// Stack uncertainty bands, in place.
+// m holds nbands rows of nbins absolute uncertainties, one row per band.
+// Each row is replaced by the sum in quadrature of itself and all rows
+// before it, divided by xsec bin by bin.
+void stack_bands(double* m, size_t nbands, size_t nbins, const double* xsec)
+noexcept;
+
+// Stacked bands of a variable, one per field other than xsec, in order.
+struct band_stack {
+  const arena_vector<double>& bins;
+  size_t nbins;
+  std::vector<const std::string*> names;
+  std::vector<double> m; // row per band
+  double max; // of the outermost band
+};
+band_stack stack_bands(const var_t& var);
+
+}
+
+#endif
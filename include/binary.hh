@@ -0,0 +1,53 @@
+#ifndef IVANP_EXP_UNC_DATA_BINARY_HH
+#define IVANP_EXP_UNC_DATA_BINARY_HH
+
+#include <cstdint>
+
+#include "reader.hh"
+
+// Binary columnar format
+//
+// "EXPUNC\0\2", u64 index size, index, padding to 8 bytes, data
+// index: u32 nvars, then per variable
+//   str name, u64 data offset, u32 nedges, u32 edge flags, u32 nfields,
+//   per field: str name, u32 flags (1 = asymmetric), u32 n
+// data of a variable, 8-byte aligned:
+//   f64 edges[nedges], f64 edges x2[nedges] if asymmetric,
+//   per field: f64 x[n], f64 x2[n] if asymmetric,
+//   u32 text lengths of all cells, then all text bytes,
+//   edges first, then fields in order
+// str is u32 length followed by bytes; numbers are little-endian.
+// Computed cells are written with text formatted to prec digits.
+
+bool is_binary(string_view buf) noexcept;
+
+// Reads variables one at a time, in the order of the index
+class bin_stream : public var_stream {
+  std::shared_ptr<const input_buffer> buf; // all input, or the index
+  std::istream* in = nullptr; // where data is read from if not mapped
+  uint64_t pos = 0; // offset in data of in's position
+  const char *dat, *end, *idx;
+  uint32_t nvars;
+  struct field { string_view name; uint32_t flags, n; };
+  std::vector<field> fields;
+public:
+  explicit bin_stream(std::shared_ptr<const input_buffer> buf);
+  // reads the index from in, whose first bytes have been read into head,
+  // then the data of a variable at a time
+  bin_stream(std::istream& in, std::string head);
+  // adds the next variable to vars if it is selected
+  bool next(dataset& vars, const var_filter& select);
+  bool next(dataset& vars) override {
+    vars.clear();
+    return next(vars,{ });
+  }
+};
+
+void read_bin(
+  const std::shared_ptr<const input_buffer>& buf, dataset& vars,
+  const var_filter& select = { });
+
+void write_bin(std::ostream& out, const dataset& vars,
+               unsigned prec = column::prec);
+
+#endif
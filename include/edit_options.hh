@@ -0,0 +1,104 @@
+#ifndef IVANP_EXP_UNC_EDIT_OPTIONS_HH
+#define IVANP_EXP_UNC_EDIT_OPTIONS_HH
+
+#include <vector>
+#include <tuple>
+#include <cstring>
+
+#include <boost/optional.hpp>
+
+#include "program_options.hh"
+#include "plan.hh"
+#include "ops.hh"
+#include "numconv.hh"
+#include "error.hh"
+
+class add_opt {
+public:
+  enum opt_type { add, qadd, eadd, eqadd };
+private:
+  enum opt_type opt;
+  using type = std::vector<const char*>;
+  type v;
+public:
+  const type& operator*() const noexcept { return v; }
+  const type* operator->() const noexcept { return &v; }
+
+  bool  inv() const noexcept { return opt==eadd || opt==eqadd; }
+  bool quad() const noexcept { return opt==qadd || opt==eqadd; }
+
+  static auto parser(opt_type opt) {
+    return [opt](const char* str, add_opt& x) {
+      if (x->empty()) x.opt = opt;
+      else if (opt!=x.opt) throw ivanp::error(
+        "only one of --add options can be used");
+      x.v.push_back(str);
+    };
+  }
+};
+
+// Options of edit that transform the data,
+// shared with the steps of pipeline.
+// Header only, as program_options can be used in one source per program.
+struct edit_options {
+  std::vector<const char*> rm, exclude, order;
+  add_opt add;
+  bool sym = false;
+  std::tuple<unsigned,const char*> top {0,"others"};
+  boost::optional<double> tol;
+  unsigned prec = column::prec;
+
+  void declare(ivanp::po::program_options& po);
+  void check() const; // after parsing
+  plan compile() const;
+};
+
+inline void edit_options::declare(ivanp::po::program_options& po) {
+  using namespace ivanp::po;
+  po
+    (rm,"--rm","remove these fields")
+    (sym,"--sym","symmetrize uncertainties (take larger)")
+    (add,"--add","sum these fields",
+      add_opt::parser(add_opt::add), multi())
+    (add,"--qadd","sum these fields in quadrature",
+      add_opt::parser(add_opt::qadd), multi())
+    (add,"--add-except","sum all fields except these",
+      add_opt::parser(add_opt::eadd), multi())
+    (add,"--qadd-except",
+      "sum all fields in quadrature except these\n"
+      "first value is the name of the sum\n"
+      "only one of the add options may be used\n"
+      "regex can be used here",
+      add_opt::parser(add_opt::eqadd), multi())
+    (top,"--top",
+      "keep top n contributions, combine others\n"
+      "n:name or n, default name is \"others\"")
+    (exclude,"--exclude","fields that won't participate")
+    (prec,"--prec","double to string precision, default is 8\n"
+      "shortest for the shortest text that reads back the same",
+      [](const char* arg, unsigned& prec){
+        if (!strcmp(arg,"shortest")) prec = ivanp::dtos_shortest;
+        else ivanp::po::arg_parser(arg,prec);
+      })
+    (tol,"--tol","fractional tolerance when comparing binning")
+    (order,"--order","set order of fields");
+}
+
+inline void edit_options::check() const {
+  if (!add.inv() && add->size()==1) throw ivanp::error(
+    "--add takes at least 2 arguments");
+}
+
+inline plan edit_options::compile() const {
+  plan steps;
+  ops::rm(steps,rm);
+  if (sym) ops::sym(steps);
+  if (!add->empty())
+    ops::add(steps,add->front(),{add->begin()+1,add->end()},
+             add.quad(),add.inv());
+  ops::top(steps,std::get<0>(top),std::get<1>(top),exclude);
+  ops::order(steps,order);
+  return steps;
+}
+
+#endif
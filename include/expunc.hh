@@ -0,0 +1,21 @@
+#ifndef IVANP_EXP_UNC_EXPUNC_HH
+#define IVANP_EXP_UNC_EXPUNC_HH
+
+// Public interface of libexpunc, the library the tools are built on.
+//   dataset         load, check and write .dat files, text or binary
+//   read_hepdata    parse HepData text records
+//   read_mc         import MC predictions
+//   ops::           operations of edit, on a plan or a whole dataset
+//   stack_bands     cumulative bands, as drawn by plot
+//   svg_page        draw a page of bands as SVG
+
+#include "reader.hh"
+#include "binary.hh"
+#include "hepdata.hh"
+#include "mc.hh"
+#include "plan.hh"
+#include "ops.hh"
+#include "bands.hh"
+#include "svg.hh"
+
+#endif
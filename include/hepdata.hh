@@ -0,0 +1,28 @@
+#ifndef IVANP_EXP_UNC_HEPDATA_HH
+#define IVANP_EXP_UNC_HEPDATA_HH
+
+#include <vector>
+#include <functional>
+
+#include "reader.hh"
+
+// Reads HepData text records into vars:
+// bins, xsec and stat, and a field per DSYS entry.
+// A repeated variable is skipped, calling repeated with its line.
+// Variables are parsed on njobs threads, all hardware threads if 0;
+// warnings and errors come in the same order either way.
+void read_hepdata(
+  const std::vector<std::shared_ptr<const input_buffer>>& bufs, dataset& vars,
+  const std::function<void(unsigned line, string_view var)>& repeated = { },
+  unsigned njobs = 1);
+
+inline void read_hepdata(
+  const std::shared_ptr<const input_buffer>& buf, dataset& vars,
+  const std::function<void(unsigned line, string_view var)>& repeated = { },
+  unsigned njobs = 1
+) {
+  read_hepdata(
+    std::vector<std::shared_ptr<const input_buffer>>{buf},vars,repeated,njobs);
+}
+
+#endif
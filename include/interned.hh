@@ -0,0 +1,59 @@
+#ifndef IVANP_EXP_UNC_INTERNED_HH
+#define IVANP_EXP_UNC_INTERNED_HH
+
+#include <string>
+#include <ostream>
+#include <cstdint>
+#include <functional>
+
+#include "string_view.hh"
+
+// Handle to a string stored once for the lifetime of the program.
+// Variable and field names repeat in every variable and file,
+// so they are kept as interned handles, compared and hashed by address.
+// Interning is safe from multiple threads.
+// Strings are never freed, so the pool grows with the number of distinct
+// names seen, not with the amount of data. Programs that run for long on
+// arbitrary input should bound pool_size(), as plot --serve does.
+class interned {
+  const std::string* p;
+  explicit interned(const std::string* p) noexcept: p(p) { }
+public:
+  interned(); // empty string
+  explicit interned(string_view s);
+  // false if s was never interned, so it cannot be a key
+  static bool find(string_view s, interned& id);
+  // bytes held by the pool
+  static size_t pool_size() noexcept;
+
+  inline const std::string& str() const noexcept { return *p; }
+  inline operator const std::string&() const noexcept { return *p; }
+  inline const char* c_str() const noexcept { return p->c_str(); }
+  inline size_t size() const noexcept { return p->size(); }
+  inline size_t hash() const noexcept {
+    const uint64_t h = uint64_t(uintptr_t(p)) * 0x9E3779B97F4A7C15ull;
+    return h ^ (h >> 32);
+  }
+
+  friend inline bool operator==(interned a, interned b) noexcept
+  { return a.p == b.p; }
+  friend inline bool operator!=(interned a, interned b) noexcept
+  { return a.p != b.p; }
+  friend inline bool operator==(interned a, string_view b) noexcept
+  { return string_view(*a.p) == b; }
+  friend inline bool operator!=(interned a, string_view b) noexcept
+  { return string_view(*a.p) != b; }
+  // alphabetical
+  friend inline bool operator<(interned a, interned b) noexcept
+  { return *a.p < *b.p; }
+  friend inline std::ostream& operator<<(std::ostream& o, interned a)
+  { return o << *a.p; }
+};
+
+namespace std {
+template <> struct hash<interned> {
+  size_t operator()(interned s) const noexcept { return s.hash(); }
+};
+}
+
+#endif
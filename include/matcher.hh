@@ -0,0 +1,41 @@
+#ifndef IVANP_EXP_UNC_MATCHER_HH
+#define IVANP_EXP_UNC_MATCHER_HH
+
+#include <string>
+#include <vector>
+#include <unordered_set>
+#include <unordered_map>
+#include <shared_mutex>
+#include <memory>
+
+#include "interned.hh"
+
+#include <boost/regex_fwd.hpp>
+
+// Tests whether a name fully matches any of a list of patterns.
+// Patterns without regex syntax are looked up in a hash set,
+// the rest are combined into a single regex.
+// Results are memoized per interned name, so matching costs
+// about one regex search per name no matter how many times it is seen.
+// Safe to call from multiple threads.
+class matcher {
+  using regex = boost::regex;
+  std::unordered_set<interned> literals;
+  std::vector<std::unique_ptr<const regex>> res;
+  mutable std::unordered_map<interned,bool> memo;
+  mutable std::shared_timed_mutex mx;
+
+  bool match(interned name) const;
+
+public:
+  matcher();
+  explicit matcher(const std::vector<const char*>& patterns);
+  matcher(matcher&&);
+  matcher& operator=(matcher&&);
+  ~matcher();
+
+  bool empty() const noexcept { return literals.empty() && res.empty(); }
+  bool operator()(interned name) const;
+};
+
+#endif
@@ -0,0 +1,34 @@
+#ifndef IVANP_EXP_UNC_MC_HH
+#define IVANP_EXP_UNC_MC_HH
+
+#include <vector>
+#include <unordered_map>
+#include <unordered_set>
+
+#include "reader.hh"
+
+// Corrections to MC predictions, read from lines
+//   bins VAR EDGES...   replace the bin edges of VAR
+//   reverse VAR         reverse the order of the values of VAR's fields
+// Empty lines and lines starting with # are skipped.
+struct mc_rules {
+  std::shared_ptr<const input_buffer> src;
+  std::unordered_map<interned,std::vector<string_view>> bins;
+  std::unordered_set<interned> reverse;
+
+  mc_rules() = default;
+  explicit mc_rules(const char* fname);
+};
+
+// Reads MC predictions, lines <generator>.<variable>.(bins|fid): values,
+// into a field per generator, applying rules.
+// Other lines are skipped, as are variables not selected.
+// Variables are sorted by name, and generators within them,
+// comparing bytes, as sort does with LC_ALL=C. The replaced scr/mc.sh
+// sorted in the user's locale, so its output matches only if that was C.
+// All generators must give the same bins for a variable.
+void read_mc(
+  const std::shared_ptr<const input_buffer>& buf, dataset& vars,
+  const mc_rules& rules = { }, const var_filter& select = { });
+
+#endif
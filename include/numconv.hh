@@ -0,0 +1,28 @@
+#ifndef IVANP_NUMCONV_HH
+#define IVANP_NUMCONV_HH
+
+#include <cstddef>
+
+#include "string_view.hh"
+
+namespace ivanp {
+
+// Locale independent conversions between doubles and text.
+// Nothing here throws.
+
+// false unless all of str is a number
+bool stod(string_view str, double& x) noexcept;
+
+// Write x to buf in fixed notation with prec digits after the point,
+// or in the shortest form that reads back as x if prec is dtos_shortest.
+// Returns the length of the text, like snprintf;
+// if it is not less than size, buf is left unspecified.
+size_t dtos(double x, unsigned prec, char* buf, size_t size) noexcept;
+
+constexpr unsigned dtos_shortest = -1;
+
+constexpr size_t dtos_size = 32; // enough unless |x| is huge
+
+}
+
+#endif
@@ -0,0 +1,67 @@
+#ifndef IVANP_EXP_UNC_OPS_HH
+#define IVANP_EXP_UNC_OPS_HH
+
+#include <vector>
+#include <functional>
+
+#include <boost/optional.hpp>
+
+#include "plan.hh"
+
+// Operations of edit.
+// Each one adds its steps to a plan, so that the field steps
+// of all of them are fused into one pass over the fields.
+// The dataset overloads apply a single operation.
+// Patterns are literal field names or regular expressions.
+namespace ops {
+
+using strings = std::vector<const char*>;
+
+// drop fields matching patterns
+void rm(plan& p, const strings& patterns);
+
+// replace asymmetric uncertainties with the larger of the two
+void sym(plan& p);
+
+// sum fields matching patterns, or all others if except,
+// linearly or in quadrature, and store the sum as field sum
+void add(plan& p, const char* sum, const strings& patterns,
+         bool quad = false, bool except = false);
+
+// keep n fields with the largest sum of fractional uncertainties,
+// combine the rest in quadrature as field name
+void top(plan& p, unsigned n, const char* name = "others",
+         const strings& exclude = { });
+
+// sort fields in this order, unlisted ones last
+void order(plan& p, const strings& fields);
+
+inline void rm(dataset& d, const strings& patterns, unsigned njobs = 1) {
+  plan p; rm(p,patterns); p(d,njobs);
+}
+inline void sym(dataset& d, unsigned njobs = 1) {
+  plan p; sym(p); p(d,njobs);
+}
+inline void add(dataset& d, const char* sum, const strings& patterns,
+                bool quad = false, bool except = false, unsigned njobs = 1) {
+  plan p; add(p,sum,patterns,quad,except); p(d,njobs);
+}
+inline void top(dataset& d, unsigned n, const char* name = "others",
+                const strings& exclude = { }, unsigned njobs = 1) {
+  plan p; top(p,n,name,exclude); p(d,njobs);
+}
+inline void order(dataset& d, const strings& fields, unsigned njobs = 1) {
+  plan p; order(p,fields); p(d,njobs);
+}
+
+// Replace or add fields of from in to.
+// Every variable of from must be in to,
+// and their binning must agree within fractional tolerance tol.
+// report is called for every field, with added false if it replaced one.
+void join(dataset& to, dataset& from, boost::optional<double> tol = { },
+          const std::function<void(bool added, interned var, interned field)>&
+            report = { });
+
+}
+
+#endif
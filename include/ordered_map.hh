@@ -3,112 +3,181 @@
 
 #include <vector>
 #include <string>
-#include <unordered_map>
+#include <utility>
 #include <algorithm>
+#include <cstdint>
 
+#include "interned.hh"
+#include "arena.hh"
 #include "error.hh"
 
+// Map with interned string keys that iterates in insertion order.
+// Entries are stored contiguously, indexed by an open addressing table.
+// Erased entries are left as tombstones, so iterators stay valid,
+// and are compacted away on the next rehash or sort.
+// Insertion may move entries, invalidating references to them.
+// Storage comes from the arena current at construction.
 template <typename T>
-struct deref_pred : T {
-  using T::T;
-  template <typename... Args>
-  inline auto operator()(const Args&... args) const {
-    return T::operator()(*args...);
-  }
-};
-
-template <typename Iterator>
-class deref_iterator {
-  Iterator it;
+class ordered_map {
 public:
-  constexpr deref_iterator(Iterator it): it(it) { }
-  inline auto& operator*() noexcept { return **it; }
-  inline auto& operator->() noexcept { return *it; }
-  inline auto& operator++() noexcept(noexcept(++it)) { ++it; return *this; }
-  constexpr bool operator==(const deref_iterator& r) const noexcept
-  { return it == r.it; }
-  constexpr bool operator!=(const deref_iterator& r) const noexcept
-  { return it != r.it; }
-  constexpr bool operator<(const deref_iterator& r) const noexcept
-  { return it < r.it; }
-  constexpr bool operator>(const deref_iterator& r) const noexcept
-  { return it > r.it; }
-  constexpr Iterator underlying() const noexcept { return it; }
-};
+  using value_type = std::pair<interned,T>;
 
-template <typename T, typename Key = std::string,
-          typename Hash = std::hash<Key>,
-          typename KeyEqual = std::equal_to<Key> >
-class ordered_map {
-  std::unordered_map<Key,T,Hash,KeyEqual> map;
-  std::vector<typename decltype(map)::iterator> order;
+private:
+  struct entry {
+    value_type kv;
+    bool dead;
+  };
+  arena_vector<entry> items;
+  arena_vector<uint32_t> table; // index into items + 1, 0 if empty
+  size_t ndead = 0;
+  static constexpr uint32_t tomb = -1;
+
+  // slot holding key, or the empty one ending its probe sequence
+  size_t find_slot(interned key) const noexcept {
+    const size_t mask = table.size()-1;
+    for (size_t i = key.hash() & mask; ; i = (i+1) & mask) {
+      const auto j = table[i];
+      if (!j || (j!=tomb && items[j-1].kv.first==key)) return i;
+    }
+  }
+  // index of key's entry + 1, 0 if none
+  uint32_t find(interned key) const noexcept {
+    return table.empty() ? 0 : table[find_slot(key)];
+  }
+  void rehash(size_t n) { // drop tombstones and make room for n entries
+    if (ndead) {
+      items.erase( std::remove_if(items.begin(), items.end(),
+        [](const entry& e){ return e.dead; }), items.end() );
+      ndead = 0;
+    }
+    size_t size = 8;
+    while (size < 3*n) size *= 2;
+    table.assign(size,0);
+    for (uint32_t i=0, m=items.size(); i<m; ++i)
+      table[find_slot(items[i].kv.first)] = i+1;
+  }
+  T& insert(interned key) {
+    if (2*(items.size()+1) > table.size()) rehash(size()+1);
+    table[find_slot(key)] = items.size()+1;
+    items.push_back({ {key,T()}, false });
+    return items.back().kv.second;
+  }
+
+  template <typename E, typename V>
+  class basic_iterator {
+    friend class ordered_map;
+    E *p, *last;
+    void skip() noexcept { while (p!=last && p->dead) ++p; }
+  public:
+    basic_iterator(E* p, E* last) noexcept: p(p), last(last) { skip(); }
+    inline V& operator*() const noexcept { return p->kv; }
+    inline V* operator->() const noexcept { return &p->kv; }
+    inline basic_iterator& operator++() noexcept { ++p; skip(); return *this; }
+    constexpr bool operator==(const basic_iterator& r) const noexcept
+    { return p == r.p; }
+    constexpr bool operator!=(const basic_iterator& r) const noexcept
+    { return p != r.p; }
+    constexpr bool operator<(const basic_iterator& r) const noexcept
+    { return p < r.p; }
+    constexpr bool operator>(const basic_iterator& r) const noexcept
+    { return p > r.p; }
+  };
 
 public:
-  using iterator =
-    deref_iterator<typename decltype(order)::iterator>;
-  using const_iterator =
-    deref_iterator<typename decltype(order)::const_iterator>;
+  using iterator = basic_iterator<entry,value_type>;
+  using const_iterator = basic_iterator<const entry,const value_type>;
 
-  template <typename K>
-  auto& operator[](K&& key) {
-    auto emp = map.emplace(
-      std::piecewise_construct,
-      std::forward_as_tuple(std::forward<K>(key)),
-      std::forward_as_tuple());
-    if (emp.second) order.push_back(emp.first);
-    return emp.first->second;
-  }
-  const auto& operator[](const Key& key) const {
-    try {
-      return map.at(key);
-    } catch (const std::out_of_range&) {
-      throw ivanp::error("no key \"",key,'\"');
-    }
+  T& operator[](interned key) {
+    const auto j = find(key);
+    return j ? items[j-1].kv.second : insert(key);
   }
-  template <typename... Args>
-  inline bool emplace(Args&&... args) {
-    auto emp = map.emplace(
-      std::piecewise_construct,
-      std::forward_as_tuple(std::forward<Args>(args)...),
-      std::forward_as_tuple());
-    if (emp.second) order.push_back(emp.first);
-    return emp.second;
+  inline T& operator[](string_view key) { return (*this)[interned(key)]; }
+  const T& operator[](interned key) const {
+    const auto j = find(key);
+    if (!j) throw ivanp::error("no key \"",key,'\"');
+    return items[j-1].kv.second;
   }
+  const T& operator[](string_view key) const {
+    interned id;
+    if (!interned::find(key,id)) throw ivanp::error("no key \"",key,'\"');
+    return (*this)[id];
+  }
+  inline size_t count(interned key) const noexcept { return find(key)!=0; }
+  inline bool emplace(interned key) {
+    if (find(key)) return false;
+    insert(key);
+    return true;
+  }
+  inline bool emplace(string_view key) { return emplace(interned(key)); }
 
-  inline iterator begin() noexcept { return order.begin(); }
-  inline iterator   end() noexcept { return order.  end(); }
-  inline const_iterator begin() const noexcept { return order.begin(); }
-  inline const_iterator   end() const noexcept { return order.  end(); }
-  inline auto size() const noexcept { return order.size(); }
-  inline auto&  back() { return *order. back(); }
-  inline auto& front() { return *order.front(); }
-  inline const auto&  back() const { return *order. back(); }
-  inline const auto& front() const { return *order.front(); }
+  inline iterator begin() noexcept
+  { return { items.data(), items.data()+items.size() }; }
+  inline iterator end() noexcept
+  { return { items.data()+items.size(), items.data()+items.size() }; }
+  inline const_iterator begin() const noexcept
+  { return { items.data(), items.data()+items.size() }; }
+  inline const_iterator end() const noexcept
+  { return { items.data()+items.size(), items.data()+items.size() }; }
+  inline size_t size() const noexcept { return items.size()-ndead; }
+  void reserve(size_t n) { // no moves until there are more than n entries
+    items.reserve(n+ndead);
+    if (2*n > table.size()) rehash(n);
+  }
+  inline bool empty() const noexcept { return !size(); }
+  inline auto& front() { return *begin(); }
+  inline const auto& front() const { return *begin(); }
+  auto& back() {
+    auto it = items.end();
+    while ((--it)->dead) ;
+    return it->kv;
+  }
+  const auto& back() const {
+    auto it = items.end();
+    while ((--it)->dead) ;
+    return it->kv;
+  }
 
-  void sort() {
-    using it_t = typename decltype(order)::value_type;
-    std::sort( order.begin(), order.end(),
-      [](const it_t& a, const it_t& b) { return a->first < b->first; }
-    );
+  void clear() noexcept {
+    items.clear();
+    table.clear();
+    ndead = 0;
   }
+
+  // entries are compared in place, then moved once
   template <typename Pred>
   void sort(Pred&& pred) {
-    using it_t = typename decltype(order)::value_type;
+    std::vector<entry*> order;
+    order.reserve(size());
+    for (auto& e : items) if (!e.dead) order.push_back(&e);
     std::sort( order.begin(), order.end(),
-      [&pred](const it_t& a, const it_t& b) { return pred(*a,*b); });
+      [&pred](const entry* a, const entry* b){ return pred(a->kv,b->kv); });
+    arena_vector<entry> sorted(items.get_allocator());
+    sorted.reserve(order.size());
+    for (auto* e : order) sorted.push_back(std::move(*e));
+    items = std::move(sorted);
+    ndead = 0;
+    rehash(items.size());
   }
-
-  bool erase_key(const Key& key) {
-    const auto it = map.find(key);
-    if (it==map.end()) return false;
-    order.erase(std::find(order.begin(),order.end(),it));
-    map.erase(it);
-    return true;
+  void sort() {
+    sort([](const value_type& a, const value_type& b){
+      return a.first < b.first; });
   }
+
   iterator erase(iterator it) {
-    auto u = it.underlying();
-    map.erase(*u);
-    return order.erase(u);
+    auto& e = *it.p;
+    table[find_slot(e.kv.first)] = tomb;
+    e.kv = value_type();
+    e.dead = true;
+    ++ndead;
+    return ++it;
+  }
+  bool erase_key(string_view key) {
+    interned id;
+    if (!interned::find(key,id)) return false;
+    const auto j = find(id);
+    if (!j) return false;
+    erase({ &items[j-1], items.data()+items.size() });
+    return true;
   }
 };
 
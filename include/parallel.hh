@@ -0,0 +1,46 @@
+#ifndef IVANP_PARALLEL_HH
+#define IVANP_PARALLEL_HH
+
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <exception>
+#include <mutex>
+
+namespace ivanp {
+
+// Call f(i) for every i in [0,n) on up to njobs threads,
+// all hardware threads if njobs is 0.
+// Indices are handed out in order; the first exception is rethrown.
+template <typename F>
+void parallel_for(size_t n, unsigned njobs, F&& f) {
+  if (!njobs) njobs = std::max(std::thread::hardware_concurrency(),1u);
+  if (njobs > n) njobs = n;
+  if (njobs < 2) {
+    for (size_t i=0; i<n; ++i) f(i);
+    return;
+  }
+  std::atomic<size_t> next { 0 };
+  std::exception_ptr err;
+  std::mutex err_mx;
+  auto work = [&]{
+    for (size_t i; (i = next++) < n; ) {
+      try { f(i); }
+      catch (...) {
+        std::lock_guard<std::mutex> lock(err_mx);
+        if (!err) err = std::current_exception();
+        next = n; // stop handing out work
+      }
+    }
+  };
+  std::vector<std::thread> threads;
+  threads.reserve(njobs-1);
+  for (unsigned i=1; i<njobs; ++i) threads.emplace_back(work);
+  work();
+  for (auto& t : threads) t.join();
+  if (err) std::rethrow_exception(err);
+}
+
+}
+
+#endif
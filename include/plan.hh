@@ -0,0 +1,51 @@
+#ifndef IVANP_EXP_UNC_PLAN_HH
+#define IVANP_EXP_UNC_PLAN_HH
+
+#include <vector>
+#include <string>
+#include <functional>
+#include <iosfwd>
+
+#include "reader.hh"
+#include "interned.hh"
+
+// Operations compiled for application to each variable.
+// All field steps are fused into a single pass over the fields,
+// applied in order to each field until one of them drops it.
+// Variable steps follow the pass, in order.
+class plan {
+public:
+  struct state {
+    var_t& var;
+    const unsigned nbins;
+    std::vector<double> acc; // accumulator for field steps
+  };
+  // returns false to drop the field
+  using field_step = std::function<bool(state&,interned,column&)>;
+  using var_step = std::function<void(state&)>;
+
+private:
+  std::vector<std::pair<std::string,field_step>> field_steps;
+  std::vector<std::pair<std::string,var_step>> var_steps;
+
+public:
+  plan& field(std::string descr, field_step f) {
+    field_steps.emplace_back(std::move(descr),std::move(f));
+    return *this;
+  }
+  plan& var(std::string descr, var_step f) {
+    var_steps.emplace_back(std::move(descr),std::move(f));
+    return *this;
+  }
+  bool empty() const noexcept {
+    return field_steps.empty() && var_steps.empty();
+  }
+
+  void operator()(var_t& var) const;
+  // to every variable, on njobs threads, all cores if 0
+  void operator()(dataset& data, unsigned njobs = 1) const;
+
+  friend std::ostream& operator<<(std::ostream& out, const plan& p);
+};
+
+#endif
@@ -5,19 +5,111 @@
 #include <fstream>
 #include <vector>
 #include <string>
+#include <memory>
+#include <functional>
+#include <cmath>
 
 #include "ordered_map.hh"
+#include "arena.hh"
 #include "string_view.hh"
+#include "error.hh"
+
+// Contents of an input file, either memory-mapped or read from a stream.
+class input_buffer {
+  std::string str;
+  void* map = nullptr;
+  size_t len = 0;
+public:
+  explicit input_buffer(const char* fname);
+  explicit input_buffer(std::istream& in);
+  explicit input_buffer(std::string&& str) noexcept
+  : str(std::move(str)), len(this->str.size()) { }
+  input_buffer(const input_buffer&) = delete;
+  input_buffer& operator=(const input_buffer&) = delete;
+  ~input_buffer();
+
+  inline string_view view() const noexcept {
+    return { map ? static_cast<const char*>(map) : str.data(), len };
+  }
+};
+
+// Values of a field, parsed once when read.
+// Text of the cells is kept only to re-emit them exactly;
+// computed cells have no text and are formatted with prec on output.
+// Vectors are allocated from the arena of the read that created them.
+struct column {
+  arena_vector<double> x;  // value, or the first one of an asymmetric pair
+  arena_vector<double> x2; // second value of an asymmetric pair, NaN if none
+  arena_vector<string_view> text; // views into src
+  std::shared_ptr<const input_buffer> src;
+  static unsigned prec;
+
+  static std::string format(double x, unsigned prec = column::prec);
+  inline auto size() const noexcept { return x.size(); }
+  inline bool empty() const noexcept { return x.empty(); }
+  inline void reserve(size_t n) { x.reserve(n); text.reserve(n); }
+  inline void clear() noexcept { x.clear(); x2.clear(); text.clear(); }
+
+  void push_back(string_view s);
+  void push_back(double v) {
+    x.push_back(v);
+    if (!x2.empty()) x2.push_back(NAN);
+    text.emplace_back();
+  }
+
+  inline bool asym(size_t i) const noexcept {
+    return !x2.empty() && !std::isnan(x2[i]);
+  }
+  inline double at(size_t i) const {
+    if (std::isnan(x[i]) || asym(i)) throw ivanp::error(
+      "cannot interpret \"",text[i],"\" as double");
+    return x[i];
+  }
+  const arena_vector<double>& values() const {
+    for (size_t i=0, n=size(); i<n; ++i) at(i);
+    return x;
+  }
+};
+
+std::ostream& operator<<(std::ostream& out, const column& col);
 
 struct var_t {
-  std::vector<std::string> bin_edges;
-  ordered_map<std::vector<std::string>> vals;
-  using all_t = ordered_map<var_t>;
-  static all_t all;
-  static void check();
+  column bin_edges;
+  ordered_map<column> vals;
 };
 
-std::ostream& operator<<(std::ostream& out, const var_t::all_t& vars);
-std::istream& operator>>(std::istream& in, var_t::all_t& vars);
+// selects variables to read, all if empty
+using var_filter = std::function<bool(string_view)>;
+
+// Variables in the order read.
+// Datasets share no state, so distinct ones can be
+// loaded, processed and written on different threads.
+class dataset : public ordered_map<var_t> {
+public:
+  // text or binary format is detected from the buffer contents
+  void load(const std::shared_ptr<const input_buffer>& buf,
+            const var_filter& select = { });
+  void load(const char* fname, const var_filter& select = { });
+  // throws unless every variable has bins and a value per bin in each field
+  void check() const;
+  // text, or the binary format,
+  // with computed cells formatted to prec digits
+  void write(std::ostream& out, bool bin = false,
+             unsigned prec = column::prec) const;
+};
+
+std::ostream& operator<<(std::ostream& out, const dataset& vars);
+std::istream& operator>>(std::istream& in, dataset& vars);
+
+// Reads input one variable at a time, to process it in bounded memory.
+// In text input, lines of a variable must be consecutive.
+class var_stream {
+public:
+  virtual ~var_stream() { }
+  // replaces contents of vars with the next variable, false at the end
+  virtual bool next(dataset& vars) = 0;
+  // reads stdin if fname is null
+  static std::unique_ptr<var_stream> open(const char* fname);
+};
 
 #endif
@@ -0,0 +1,155 @@
+#ifndef IVANP_EXP_UNC_SERVE_HH
+#define IVANP_EXP_UNC_SERVE_HH
+
+// Protocol between plot --serve and plotc, over a Unix socket.
+// The client sends its stdout and stderr with SCM_RIGHTS along with
+// the first byte of the request: u32 length, then the working directory
+// and the arguments, each terminated by NUL.
+// The server runs the job writing to the client's descriptors,
+// then replies with one byte, the exit status.
+// Each side only talks to processes of the same user.
+
+#include <string>
+#include <vector>
+#include <cstdlib>
+#include <cstring>
+#include <cstdint>
+#include <cerrno>
+
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+
+namespace ivanp { namespace serve {
+
+// $PLOT_SOCKET, or plot.sock in $XDG_RUNTIME_DIR or /tmp/plot-UID
+inline std::string socket_path() {
+  if (const char* env = std::getenv("PLOT_SOCKET")) return env;
+  const char* dir = std::getenv("XDG_RUNTIME_DIR");
+  if (dir && *dir) return std::string(dir) + "/plot.sock";
+  return "/tmp/plot-" + std::to_string(getuid()) + "/plot.sock";
+}
+
+// Creates the directory of the socket, accessible only by the user,
+// if it does not exist. False unless it is the user's
+// and others cannot replace the socket in it.
+inline bool socket_dir(const std::string& path) {
+  const auto slash = path.rfind('/');
+  const std::string dir = slash==std::string::npos ? "."
+    : slash==0 ? "/" : path.substr(0,slash);
+  if (::mkdir(dir.c_str(),0700) && errno!=EEXIST) return false;
+  struct stat st;
+  return !::lstat(dir.c_str(),&st) && S_ISDIR(st.st_mode)
+      && st.st_uid==getuid() && !(st.st_mode & (S_IWGRP|S_IWOTH));
+}
+
+// whether the process at the other end is of the same user
+inline bool same_user(int sock) {
+  ucred cred;
+  socklen_t len = sizeof(cred);
+  return !::getsockopt(sock,SOL_SOCKET,SO_PEERCRED,&cred,&len)
+      && len==sizeof(cred) && cred.uid==getuid();
+}
+
+inline bool address(const std::string& path, sockaddr_un& addr) {
+  if (path.size() >= sizeof(addr.sun_path)) return false;
+  std::memset(&addr,0,sizeof(addr));
+  addr.sun_family = AF_UNIX;
+  std::memcpy(addr.sun_path,path.c_str(),path.size()+1);
+  return true;
+}
+
+inline bool write_all(int fd, const char* p, size_t n) {
+  while (n) {
+    const ssize_t w = ::write(fd,p,n);
+    if (w<0) {
+      if (errno==EINTR) continue;
+      return false;
+    }
+    p += w, n -= w;
+  }
+  return true;
+}
+inline bool read_all(int fd, char* p, size_t n) {
+  while (n) {
+    const ssize_t r = ::read(fd,p,n);
+    if (r<0 && errno==EINTR) continue;
+    if (r<=0) return false;
+    p += r, n -= r;
+  }
+  return true;
+}
+
+// fds: stdout and stderr to write to
+inline bool send_request(int sock, const int (&fds)[2],
+                         const std::vector<std::string>& args) {
+  std::string msg(sizeof(uint32_t),'\0');
+  for (const auto& arg : args) msg.append(arg.c_str(),arg.size()+1);
+  const uint32_t len = msg.size() - sizeof(uint32_t);
+  std::memcpy(&msg[0],&len,sizeof(len));
+
+  char ctrl[CMSG_SPACE(sizeof(fds))] = { };
+  iovec iov { &msg[0], 1 };
+  msghdr hdr { };
+  hdr.msg_iov = &iov;
+  hdr.msg_iovlen = 1;
+  hdr.msg_control = ctrl;
+  hdr.msg_controllen = sizeof(ctrl);
+  cmsghdr* c = CMSG_FIRSTHDR(&hdr);
+  c->cmsg_level = SOL_SOCKET;
+  c->cmsg_type = SCM_RIGHTS;
+  c->cmsg_len = CMSG_LEN(sizeof(fds));
+  std::memcpy(CMSG_DATA(c),fds,sizeof(fds));
+  ssize_t w;
+  while ((w = ::sendmsg(sock,&hdr,0))<0 && errno==EINTR) ;
+  return w==1 && write_all(sock,msg.data()+1,msg.size()-1);
+}
+
+// args: working directory, then argv
+// fds that were received are set even if false is returned,
+// for the caller to close
+inline bool recv_request(int sock, int (&fds)[2],
+                         std::vector<std::string>& args) {
+  char first;
+  char ctrl[CMSG_SPACE(sizeof(fds))] = { };
+  iovec iov { &first, 1 };
+  msghdr hdr { };
+  hdr.msg_iov = &iov;
+  hdr.msg_iovlen = 1;
+  hdr.msg_control = ctrl;
+  hdr.msg_controllen = sizeof(ctrl);
+  ssize_t r;
+  while ((r = ::recvmsg(sock,&hdr,MSG_CMSG_CLOEXEC))<0 && errno==EINTR) ;
+  const cmsghdr* c = r<0 ? nullptr : CMSG_FIRSTHDR(&hdr);
+  if (c && c->cmsg_level==SOL_SOCKET && c->cmsg_type==SCM_RIGHTS) {
+    if (c->cmsg_len==CMSG_LEN(sizeof(fds)))
+      std::memcpy(fds,CMSG_DATA(c),sizeof(fds));
+    else { // close whatever was sent
+      for (size_t i=0, n=(c->cmsg_len-CMSG_LEN(0))/sizeof(int); i<n; ++i) {
+        int fd;
+        std::memcpy(&fd,CMSG_DATA(c)+i*sizeof(int),sizeof(fd));
+        ::close(fd);
+      }
+      return false;
+    }
+  }
+  if (r!=1 || fds[0]==-1) return false;
+
+  char len_bytes[sizeof(uint32_t)] = { first };
+  uint32_t len;
+  if (!read_all(sock,len_bytes+1,sizeof(len)-1)) return false;
+  std::memcpy(&len,len_bytes,sizeof(len));
+  std::string msg(len,'\0');
+  if (!read_all(sock,&msg[0],len)) return false;
+  args.clear();
+  for (size_t a=0, b; a<len; a=b+1) {
+    if ((b = msg.find('\0',a))==std::string::npos) return false;
+    args.emplace_back(msg,a,b-a);
+  }
+  return args.size() > 1;
+}
+
+}}
+
+#endif
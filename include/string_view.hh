@@ -15,6 +15,24 @@ inline string_view view(
   return { str.data()+p, n };
 }
 
+inline string_view view(
+  string_view str,
+  string_view::size_type p = 0,
+  string_view::size_type n = string_view::npos
+) noexcept {
+  if (p>=str.size() || n==0) return { };
+  return str.substr(p,n);
+}
+
+// pop the next line off the buffer
+inline bool getline(string_view& sv, string_view& line) noexcept {
+  if (sv.empty()) return false;
+  const auto d = sv.find('\n');
+  line = sv.substr(0,d);
+  sv.remove_prefix(d==string_view::npos ? sv.size() : d+1);
+  return true;
+}
+
 inline void ltrim(string_view& sv, const char* ds = " \t") {
   sv.remove_prefix(sv.find_first_not_of(ds));
 }
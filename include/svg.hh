@@ -0,0 +1,54 @@
+#ifndef IVANP_EXP_UNC_SVG_HH
+#define IVANP_EXP_UNC_SVG_HH
+
+#include <array>
+#include <vector>
+#include <string>
+#include <iosfwd>
+
+#include "string_view.hh"
+
+// Converts a subset of TLatex to SVG text content:
+// #it, #bf, _{}, ^{}, #sqrt{}, greek letters and a few symbols.
+// Returns false if str uses anything else.
+bool svg_latex(string_view str, std::string& out);
+
+// A page of stacked bands, drawn without ROOT.
+// Sizes and positions follow ROOT conventions:
+// coordinates are fractions of the page, text sizes of its height.
+struct svg_page {
+  struct rgb { unsigned char r, g, b; };
+  struct band {
+    std::string label; // TLatex
+    rgb fill, line;
+    short line_style; // 1 is solid
+    const double* values; // one per bin
+  };
+  struct text {
+    float x, y;
+    std::string str; // TLatex
+    short font; // ROOT font code
+    float size;
+  };
+
+  float width = 700, height = 500;
+  std::array<float,4> margins; // left, right, bottom, top
+  std::vector<double> bins;
+  std::vector<std::string> bin_labels; // replace numbers if not empty
+  float label_size = 0.05;
+  std::string xtitle, ytitle; // TLatex
+  float xoffset = 1, yoffset = 1, xtitle_size = 0.05, ytitle_size = 0.05;
+  double ymax;
+  std::vector<band> bands; // in stacking order, drawn from the last
+  std::array<float,4> legend; // x1, y1, x2, y2
+  float legend_text_size = 0.04;
+  std::vector<text> texts;
+
+  // false, and nothing written, if some text needs ROOT
+  bool write(std::ostream& out) const;
+
+  // ROOT's default color with index i, black if there is none
+  static rgb color(short i);
+};
+
+#endif
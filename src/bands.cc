@@ -0,0 +1,40 @@
+#include "bands.hh"
+
+#include <cmath>
+
+#include "math.hh"
+
+// Loops are kept simple for the compiler to vectorize them;
+// this file is compiled with -fno-math-errno for sqrt.
+
+void ivanp::stack_bands(
+  double* __restrict m, size_t nbands, size_t nbins,
+  const double* __restrict xsec
+) noexcept {
+  if (!nbands) return;
+  for (size_t j=0; j<nbins; ++j) m[j] *= m[j];
+  for (size_t i=1; i<nbands; ++i) {
+    double* __restrict row = m + i*nbins;
+    const double* __restrict prev = row - nbins;
+    for (size_t j=0; j<nbins; ++j) row[j] = prev[j] + row[j]*row[j];
+  }
+  for (double *row = m, * const end = m + nbands*nbins; row!=end; row+=nbins)
+    for (size_t j=0; j<nbins; ++j) row[j] = std::sqrt(row[j])/xsec[j];
+}
+
+ivanp::band_stack ivanp::stack_bands(const var_t& var) {
+  const auto& xsec = var.vals["xsec"].values();
+  band_stack s { var.bin_edges.values(), xsec.size(), { }, { }, 0. };
+  const auto nbands = var.vals.size()-1;
+  s.names.reserve(nbands);
+  s.m.reserve(nbands*s.nbins);
+  for (const auto& val : var.vals) {
+    if (val.first=="xsec") continue;
+    s.names.push_back(&val.first.str());
+    const auto& x = val.second.values();
+    s.m.insert(s.m.end(),x.begin(),x.end());
+  }
+  stack_bands(s.m.data(),nbands,s.nbins,xsec.data());
+  for (auto j=s.m.end()-s.nbins; j!=s.m.end(); ++j) math::larger(s.max,*j);
+  return s;
+}
@@ -0,0 +1,280 @@
+#include "binary.hh"
+#include "numconv.hh"
+
+#include <cstring>
+#include <cstdint>
+#include <cmath>
+#include <algorithm>
+
+using ivanp::error;
+
+namespace {
+
+constexpr char magic[8] = { 'E','X','P','U','N','C','\0','\2' };
+
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+template <typename T>
+inline T le(T x) noexcept {
+  char* p = reinterpret_cast<char*>(&x);
+  std::reverse(p,p+sizeof(T));
+  return x;
+}
+#else
+template <typename T>
+constexpr T le(T x) noexcept { return x; }
+#endif
+
+template <typename T>
+inline void put(std::string& s, T x) {
+  x = le(x);
+  s.append(reinterpret_cast<const char*>(&x),sizeof(x));
+}
+inline void put_str(std::string& s, string_view str) {
+  put<uint32_t>(s,str.size());
+  s.append(str.data(),str.size());
+}
+inline void align(std::string& s) { s.resize((s.size()+7) & ~size_t(7)); }
+
+class bin_reader {
+  const char *p, *end;
+  void need(size_t n) const {
+    if (size_t(end-p) < n) throw error("truncated binary input");
+  }
+public:
+  bin_reader(const char* p, const char* end): p(p), end(end) { }
+  const char* pos() const noexcept { return p; }
+
+  template <typename T>
+  T get() {
+    need(sizeof(T));
+    T x;
+    memcpy(&x,p,sizeof(T));
+    p += sizeof(T);
+    return le(x);
+  }
+  string_view str() {
+    const auto n = get<uint32_t>();
+    need(n);
+    const string_view s(p,n);
+    p += n;
+    return s;
+  }
+  void f64(arena_vector<double>& v, size_t n) {
+    need(n*sizeof(double));
+    v.resize(n);
+    memcpy(v.data(),p,n*sizeof(double));
+    p += n*sizeof(double);
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    for (auto& x : v) x = le(x);
+#endif
+  }
+  void text(column& col, size_t n, const char*& bytes) {
+    need(n*sizeof(uint32_t));
+    col.text.resize(n);
+    for (auto& s : col.text) {
+      const auto len = get<uint32_t>();
+      if (size_t(end-bytes) < len) throw error("truncated binary input");
+      s = { bytes, len };
+      bytes += len;
+    }
+  }
+};
+
+// append n bytes of in to str, or all that is left
+void read_n(std::istream& in, std::string& str, size_t n = -1) {
+  const bool all = (n==size_t(-1));
+  char block[1<<16];
+  for (std::streamsize m; n && (m = in.rdbuf()->sgetn(
+         block,std::min(n,sizeof(block)))) > 0; )
+    str.append(block,m), n -= all ? 0 : m;
+  if (n && !all) throw error("truncated binary input");
+}
+
+}
+
+bool is_binary(string_view buf) noexcept {
+  return buf.size() >= sizeof(magic) && !memcmp(buf.data(),magic,sizeof(magic));
+}
+
+void write_bin(std::ostream& out, const dataset& vars, unsigned prec) {
+  std::string idx, dat;
+  std::vector<std::string> fmt; // text of computed cells, in order
+  put<uint32_t>(idx,vars.size());
+  for (const auto& var : vars) {
+    const auto& edges = var.second.bin_edges;
+    const auto& vals  = var.second.vals;
+    put_str(idx,var.first.str());
+    put<uint64_t>(idx,dat.size());
+    put<uint32_t>(idx,edges.size());
+    put<uint32_t>(idx,!edges.x2.empty());
+    put<uint32_t>(idx,vals.size());
+
+    size_t size = 0;
+    auto col_size = [&](const column& col){
+      size += (col.x.size() + col.x2.size())*sizeof(double)
+            + col.size()*sizeof(uint32_t);
+      for (const auto& t : col.text) size += t.size();
+    };
+    col_size(edges);
+    for (const auto& v : vals) col_size(v.second);
+    dat.reserve(dat.size()+size+8);
+
+    fmt.clear();
+    auto put_f64 = [&](const arena_vector<double>& x){
+      const size_t n = dat.size();
+      dat.resize(n+x.size()*sizeof(double));
+      memcpy(&dat[n],x.data(),x.size()*sizeof(double));
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+      for (size_t i=n; i<dat.size(); i+=sizeof(double))
+        std::reverse(&dat[i],&dat[i+sizeof(double)]);
+#endif
+    };
+    auto put_col = [&](const column& col){
+      const size_t n = dat.size();
+      put_f64(col.x);
+      for (size_t i=0, m=col.size(); i<m; ++i) {
+        if (!col.text[i].empty()) continue;
+        // round to the printed precision, as if re-read from text
+        double x = NAN;
+        fmt.push_back(column::format(col.x[i],prec));
+        ivanp::stod(fmt.back(),x);
+        x = le(x);
+        memcpy(&dat[n+i*sizeof(double)],&x,sizeof(double));
+      }
+      put_f64(col.x2);
+    };
+    put_col(edges);
+    for (const auto& v : vals) {
+      put_str(idx,v.first.str());
+      put<uint32_t>(idx,!v.second.x2.empty());
+      put<uint32_t>(idx,v.second.size());
+      put_col(v.second);
+    }
+
+    for (bool bytes : {false,true}) {
+      auto f = fmt.begin();
+      auto text = [&](const column& col){
+        for (const auto& t : col.text) {
+          const string_view s = t.empty() ? string_view(*f++) : t;
+          if (bytes) dat.append(s.data(),s.size());
+          else put<uint32_t>(dat,s.size());
+        }
+      };
+      text(edges);
+      for (const auto& v : vals) text(v.second);
+    }
+    align(dat);
+  }
+
+  std::string head(magic,sizeof(magic));
+  put<uint64_t>(head,idx.size());
+  head += idx;
+  align(head);
+  out.write(head.data(),head.size());
+  out.write(dat.data(),dat.size());
+}
+
+bin_stream::bin_stream(std::shared_ptr<const input_buffer> b)
+: buf(std::move(b)) {
+  const auto data = buf->view();
+  if (!is_binary(data)) throw error("not a binary data file");
+  end = data.end();
+  bin_reader r(data.data()+sizeof(magic),end);
+  const auto idx_size = r.get<uint64_t>();
+  if (idx_size > size_t(end-r.pos())) throw error("truncated binary input");
+  dat = data.data()
+    + ((sizeof(magic)+sizeof(uint64_t)+idx_size+7) & ~size_t(7));
+  nvars = r.get<uint32_t>();
+  idx = r.pos();
+}
+
+bin_stream::bin_stream(std::istream& in, std::string head): in(&in) {
+  if (!is_binary(head)) throw error("not a binary data file");
+  read_n(in,head,sizeof(uint64_t));
+  bin_reader r(head.data()+sizeof(magic),head.data()+head.size());
+  const auto idx_size = r.get<uint64_t>();
+  read_n(in,head,((idx_size+7) & ~size_t(7)));
+  buf = std::make_shared<const input_buffer>(std::move(head));
+  const auto data = buf->view();
+  dat = end = data.end();
+  idx = data.data() + sizeof(magic) + sizeof(uint64_t);
+  nvars = bin_reader(idx,end).get<uint32_t>();
+  idx += sizeof(uint32_t);
+}
+
+bool bin_stream::next(dataset& vars, const var_filter& select) {
+  if (!nvars) return false;
+  arena::scope scope;
+  --nvars;
+  bin_reader r(idx,end);
+  const auto var_name = r.str();
+  const auto offset = r.get<uint64_t>();
+  const auto nedges = r.get<uint32_t>();
+  const auto edge_flags = r.get<uint32_t>();
+  fields.resize(r.get<uint32_t>());
+  for (auto& f : fields) {
+    f.name = r.str();
+    f.flags = r.get<uint32_t>();
+    f.n = r.get<uint32_t>();
+  }
+  idx = r.pos();
+
+  // data of the variable, from where it starts to where the next one does
+  auto src = buf;
+  const char *vdat = dat + offset, *vend = end;
+  if (in) {
+    if (offset < pos) throw error("bad offset in binary input");
+    std::string block;
+    read_n(*in,block,offset-pos);
+    block.clear();
+    if (nvars) {
+      bin_reader next(idx,end);
+      next.str();
+      pos = next.get<uint64_t>();
+      if (pos < offset) throw error("bad offset in binary input");
+      read_n(*in,block,pos-offset);
+    } else read_n(*in,block);
+    if (select && !select(var_name)) return true;
+    src = std::make_shared<const input_buffer>(std::move(block));
+    vdat = src->view().begin();
+    vend = src->view().end();
+  } else {
+    if (select && !select(var_name)) return true; // data is never touched
+    if (offset > size_t(end-dat)) throw error("truncated binary input");
+  }
+
+  size_t nx = nedges * (edge_flags & 1 ? 2 : 1), ncells = nedges;
+  for (const auto& f : fields) {
+    nx += f.n * (f.flags & 1 ? 2 : 1);
+    ncells += f.n;
+  }
+  if (nx*sizeof(double)+ncells*sizeof(uint32_t) > size_t(vend-vdat))
+    throw error("truncated binary input");
+  bin_reader d(vdat,vend), t(vdat+nx*sizeof(double),vend);
+  const char* bytes = t.pos() + ncells*sizeof(uint32_t);
+
+  auto& x = vars[var_name];
+  if (!x.bin_edges.empty()) throw error(
+    "repeated binning for variable \"",var_name,'\"');
+  d.f64(x.bin_edges.x,nedges);
+  if (edge_flags & 1) d.f64(x.bin_edges.x2,nedges);
+  t.text(x.bin_edges,nedges,bytes);
+  x.bin_edges.src = src;
+  for (const auto& f : fields) {
+    if (!x.vals.emplace(f.name)) throw error(
+      "repeated field \"",f.name,"\" in variable \"",var_name,'\"');
+    auto& col = x.vals.back().second;
+    d.f64(col.x,f.n);
+    if (f.flags & 1) d.f64(col.x2,f.n);
+    t.text(col,f.n,bytes);
+    col.src = src;
+  }
+  return true;
+}
+
+void read_bin(
+  const std::shared_ptr<const input_buffer>& buf, dataset& vars,
+  const var_filter& select
+) {
+  for (bin_stream s(buf); s.next(vars,select); ) ;
+}
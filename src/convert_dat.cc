@@ -0,0 +1,55 @@
+#include <cstring>
+
+#include "reader.hh"
+#include "binary.hh"
+#include "program_options.hh"
+#include "termcolor.hpp"
+
+using std::cout;
+using std::cerr;
+using std::endl;
+namespace tc = termcolor;
+
+std::ostream& operator<<(std::ostream& out, const std::exception& e) {
+  return out << tc::red << e.what() << tc::reset;
+}
+
+int main(int argc, char* argv[]) {
+  const char *ifname = nullptr, *ofname = nullptr, *format = nullptr;
+
+  try {
+    using namespace ivanp::po;
+    using ivanp::po::error;
+    if (program_options()
+      (ifname,'i',"input file name",pos())
+      (ofname,'o',"output file name")
+      (format,{"-f","--format"},"output format: text or bin\n"
+        "default: the one the input is not in")
+      .parse(argc,argv)) return 0;
+
+    if (format && strcmp(format,"text") && strcmp(format,"bin")) throw error(
+      "unknown format \"",format,'\"');
+  } catch (const std::exception& e) {
+    cerr << e << endl;
+    return 1;
+  }
+
+  bool bin;
+  dataset data;
+  try {
+    const auto buf = ifname
+      ? std::make_shared<const input_buffer>(ifname)
+      : std::make_shared<const input_buffer>(std::cin);
+    bin = format ? !strcmp(format,"bin") : !is_binary(buf->view());
+    data.load(buf);
+    data.check();
+  } catch (const std::exception& e) {
+    cerr << e << endl;
+    return 1;
+  }
+
+  std::ofstream fout;
+  if (ofname) fout.open(ofname);
+  std::ostream& out = ofname ? fout : cout;
+  data.write(out,bin);
+}
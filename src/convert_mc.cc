@@ -0,0 +1,66 @@
+#include <unordered_set>
+
+#include "mc.hh"
+#include "program_options.hh"
+#include "termcolor.hpp"
+
+#define STR_IMPL(x) #x
+#define STR(x) STR_IMPL(x)
+
+using std::cout;
+using std::cerr;
+using std::endl;
+namespace tc = termcolor;
+
+std::ostream& operator<<(std::ostream& out, const std::exception& e) {
+  return out << tc::red << e.what() << tc::reset;
+}
+
+int main(int argc, char* argv[]) {
+  const char *ifname = nullptr, *ofname = nullptr, *vfname = nullptr,
+             *rfname = STR(CONFIG) "/mc_rules.txt";
+  bool bin = false;
+
+  try {
+    using namespace ivanp::po;
+    if (program_options()
+      (ifname,'i',"input file name",pos())
+      (ofname,'o',"output file name")
+      (vfname,"--vars","read only the variables in this data file")
+      (rfname,'r',"corrections to the predictions\n"
+        "default is config/mc_rules.txt")
+      (bin,"--bin","write output in binary format")
+      .parse(argc,argv)) return 0;
+  } catch (const std::exception& e) {
+    cerr << e << endl;
+    return 1;
+  }
+
+  dataset data;
+  try {
+    std::unordered_set<interned> names;
+    if (vfname) {
+      dataset ref;
+      ref.load(vfname);
+      for (const auto& var : ref) names.insert(var.first);
+    }
+    const mc_rules rules(rfname);
+    read_mc(
+      ifname
+        ? std::make_shared<const input_buffer>(ifname)
+        : std::make_shared<const input_buffer>(std::cin),
+      data, rules,
+      vfname ? var_filter([&](string_view name){
+        interned id;
+        return interned::find(name,id) && names.count(id);
+      }) : var_filter());
+    data.check();
+  } catch (const std::exception& e) {
+    cerr << e << endl;
+    return 1;
+  }
+
+  std::ofstream fout;
+  if (ofname) fout.open(ofname);
+  data.write(ofname ? fout : cout, bin);
+}
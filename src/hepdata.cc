@@ -0,0 +1,209 @@
+#include "hepdata.hh"
+
+#include <vector>
+#include <exception>
+
+#include "parallel.hh"
+#include "error.hh"
+
+using ivanp::error;
+
+namespace {
+
+// Parses the lines following the *dataset: line of a variable,
+// up to the first one starting with '*' or empty after the bins.
+void read_variable(
+  string_view& data, unsigned& line_n, interned var_name, var_t& var
+) {
+  // Columns of the variable, by position of the DSYS entry.
+  // Pointers are looked up again when a new field moves the columns.
+  // Fields are counted in the first bin, columns grow with the bins.
+  constexpr size_t nbins = 16;
+  column *xsec_col = nullptr, *stat_col = nullptr;
+  std::vector<std::pair<string_view,column*>> slots;
+  const auto field = [&](string_view name) -> column& {
+    const column* front =
+      var.vals.empty() ? nullptr : &var.vals.front().second;
+    auto& col = var.vals[name];
+    if (col.empty()) col.reserve(nbins);
+    if (!front || front==&var.vals.front().second) return col;
+    if (xsec_col) xsec_col = &var.vals["xsec"];
+    if (stat_col) stat_col = &var.vals["stat"];
+    for (auto& slot : slots) slot.second = &var.vals[slot.first];
+    return var.vals[name];
+  };
+
+  for (string_view line; getline(data,line); ) {
+    ++line_n;
+    const bool star = line.starts_with('*');
+    if (star && var.bin_edges.empty()) continue;
+    if (star || line.empty()) return;
+    // parse bin information
+    const auto d1 = line.find(';');
+    if (d1==std::string::npos) throw error(
+      "Line ",line_n,": expected \';\'");
+    auto chunk = view(line,0,d1);
+
+    const auto min = peal_head(chunk);
+    const auto to  = peal_head(chunk);
+    const auto max = peal_head(chunk);
+
+    if (!min || !max || to!="TO") throw error(
+      "Line ",line_n,": unexpected bin definition: ",view(line,0,d1));
+
+    if (var.bin_edges.empty()) var.bin_edges.push_back(min);
+    else if (var.bin_edges.text.back()!=min) throw error(
+      "Line ",line_n,": mismatch in bin edges: in \"",var_name,"\" ",
+      var.bin_edges.text.back()," and ",min);
+    var.bin_edges.push_back(max);
+
+    const auto d2 = line.find('(',d1+1);
+    if (d2==std::string::npos) throw error(
+      "Line ",line_n,": expected \'(\'");
+    chunk = view(line,d1+1,d2-d1-1);
+
+    const auto xsec = peal_head(chunk);
+    const auto pm   = peal_head(chunk);
+    const auto stat = peal_head(chunk);
+
+    if (!xsec || !stat || pm!="+-") throw error(
+      "Line ",line_n,": unexpected bin definition: ",
+      view(line,d1+1,d2-d1-1));
+    if (!xsec_col) { // first bin of the variable
+      size_t nfields = 2;
+      for (auto p = line.find("DSYS=",d2); p!=std::string::npos;
+           p = line.find("DSYS=",p+5)) ++nfields;
+      var.vals.reserve(nfields);
+      var.bin_edges.reserve(nbins+1);
+      xsec_col = &field("xsec");
+      stat_col = &field("stat");
+    }
+    xsec_col->push_back(xsec);
+    stat_col->push_back(stat);
+
+    // DSYS=value:name entries are separated by ",DSYS=",
+    // the last one ends at the last ')'
+    const string_view sep(",DSYS=");
+    for (size_t k=0, first=d2+1, last; ; ++k) {
+      last = line.find(sep,first+5);
+      const bool eol = last==std::string::npos;
+      if (eol && (last = line.rfind(')'))==std::string::npos) throw error(
+        "Line ",line_n,": missing closing \')\'");
+
+      first += 5; // DSYS=
+      const auto chunk = view(line,first,last-first);
+      const auto d = chunk.find(':');
+      const auto name = chunk.substr(d+1);
+
+      // fields usually come in the same order in every bin
+      if (k==slots.size()) slots.emplace_back(name,&field(name));
+      else if (slots[k].first!=name) slots[k] = { name, &field(name) };
+      slots[k].second->push_back(chunk.substr(0,d));
+
+      if (eol) break;
+      first = last + 1;
+    }
+  }
+}
+
+// Same as read_variable, without parsing the bins
+void skip_variable(string_view& data, unsigned& line_n) {
+  bool bins = false;
+  for (string_view line; getline(data,line); ) {
+    ++line_n;
+    const bool star = line.starts_with('*');
+    if (star && !bins) continue;
+    if (star || line.empty()) return;
+    bins = true;
+  }
+}
+
+// cell text points into the input buffer
+void set_src(var_t& var, const std::shared_ptr<const input_buffer>& buf) {
+  var.bin_edges.src = buf;
+  for (auto& v : var.vals) v.second.src = buf;
+}
+
+}
+
+void read_hepdata(
+  const std::vector<std::shared_ptr<const input_buffer>>& bufs, dataset& vars,
+  const std::function<void(unsigned,string_view)>& repeated,
+  unsigned njobs
+) {
+  arena::scope scope;
+
+  if (njobs==1) {
+    for (const auto& buf : bufs) {
+      unsigned line_n = 0;
+      auto data = buf->view();
+      for (string_view line; getline(data,line); ) {
+        ++line_n;
+        if (!line.starts_with("*dataset:")) continue;
+        const auto var_name = view(line,line.rfind('/')+1);
+        if (!vars.emplace(var_name)) {
+          if (repeated) repeated(line_n,var_name);
+          continue;
+        }
+        auto& x = vars.back();
+        read_variable(data,line_n,x.first,x.second);
+        set_src(x.second,buf);
+      }
+    }
+    return;
+  }
+
+  // Split the input into variables, parse them concurrently,
+  // then report repeated variables and errors in the order of the input.
+  struct task {
+    const std::shared_ptr<const input_buffer>* buf;
+    string_view text;
+    unsigned line_n; // of the *dataset: line
+    interned name;
+    bool repeated;
+    var_t* var;
+    std::exception_ptr err;
+  };
+  std::vector<task> tasks;
+  for (const auto& buf : bufs) {
+    unsigned line_n = 0;
+    auto data = buf->view();
+    for (string_view line; getline(data,line); ) {
+      ++line_n;
+      if (!line.starts_with("*dataset:")) continue;
+      const interned name(view(line,line.rfind('/')+1));
+      if (!vars.emplace(name)) {
+        tasks.push_back({ &buf, { }, line_n, name, true, nullptr, nullptr });
+        continue;
+      }
+      const auto first = data.begin();
+      const auto first_n = line_n;
+      skip_variable(data,line_n);
+      tasks.push_back({ &buf, string_view(first,data.begin()-first), first_n,
+        name, false, nullptr, nullptr });
+    }
+  }
+  // variables don't move any more
+  for (auto& t : tasks) if (!t.repeated) t.var = &vars[t.name];
+
+  ivanp::parallel_for(tasks.size(),njobs,[&](size_t i){
+    auto& t = tasks[i];
+    if (t.repeated) return;
+    try {
+      arena::scope scope; // own arena on other threads
+      var_t var;
+      auto line_n = t.line_n;
+      read_variable(t.text,line_n,t.name,var);
+      set_src(var,*t.buf);
+      *t.var = std::move(var);
+    } catch (...) {
+      t.err = std::current_exception();
+    }
+  });
+
+  for (const auto& t : tasks) {
+    if (t.repeated) {
+      if (repeated) repeated(t.line_n,t.name.str());
+    } else if (t.err) std::rethrow_exception(t.err);
+  }
+}
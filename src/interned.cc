@@ -0,0 +1,77 @@
+#include "interned.hh"
+
+#include <deque>
+#include <vector>
+#include <mutex>
+#include <shared_mutex>
+#include <atomic>
+
+namespace {
+
+size_t fnv1a(string_view s) noexcept {
+  size_t h = 14695981039346656037ull;
+  for (char c : s) h = (h ^ (unsigned char)c) * 1099511628211ull;
+  return h;
+}
+
+// strings never move, the table is open addressing with linear probing
+class pool_t {
+  std::deque<std::string> strs;
+  std::vector<const std::string*> table = std::vector<const std::string*>(64);
+  std::shared_timed_mutex mx;
+  size_t chars = 0;
+  std::atomic<size_t> bytes { 0 };
+
+  size_t find_slot(string_view s, size_t h) const noexcept {
+    const size_t mask = table.size()-1;
+    for (size_t i = h & mask; ; i = (i+1) & mask)
+      if (!table[i] || string_view(*table[i])==s) return i;
+  }
+
+public:
+  size_t size() const noexcept { return bytes; }
+  const std::string* find(string_view s) {
+    std::shared_lock<std::shared_timed_mutex> lock(mx);
+    return table[find_slot(s,fnv1a(s))];
+  }
+  const std::string* intern(string_view s) {
+    const size_t h = fnv1a(s);
+    { std::shared_lock<std::shared_timed_mutex> lock(mx);
+      if (const auto* p = table[find_slot(s,h)]) return p;
+    }
+    std::lock_guard<std::shared_timed_mutex> lock(mx);
+    auto& slot = table[find_slot(s,h)];
+    if (slot) return slot; // interned by another thread
+    strs.emplace_back(s.data(),s.size());
+    slot = &strs.back();
+    if (2*strs.size() > table.size()) {
+      table.assign(table.size()*2,nullptr);
+      for (const auto& str : strs) table[find_slot(str,fnv1a(str))] = &str;
+    }
+    chars += s.size();
+    bytes = chars + strs.size()*sizeof(std::string)
+          + table.size()*sizeof(table[0]);
+    return &strs.back();
+  }
+};
+
+pool_t& pool() {
+  static pool_t p;
+  return p;
+}
+
+}
+
+interned::interned() {
+  static const std::string* const empty = pool().intern({ });
+  p = empty;
+}
+interned::interned(string_view s): p(pool().intern(s)) { }
+
+size_t interned::pool_size() noexcept { return pool().size(); }
+
+bool interned::find(string_view s, interned& id) {
+  const auto* p = pool().find(s);
+  if (p) id.p = p;
+  return p;
+}
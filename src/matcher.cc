@@ -0,0 +1,69 @@
+#include "matcher.hh"
+
+#include <cstring>
+#include <mutex>
+
+#include <boost/regex.hpp>
+
+namespace {
+
+bool is_literal(const char* str) noexcept {
+  return !str[strcspn(str,".[]{}()\\*+?|^$")];
+}
+// group numbers change when combined
+bool has_backref(const char* str) noexcept {
+  for (; *str; ++str)
+    if (str[0]=='\\' && str[1]>='1' && str[1]<='9') return true;
+  return false;
+}
+
+}
+
+matcher::matcher() = default;
+matcher::matcher(matcher&& o)
+: literals(std::move(o.literals)), res(std::move(o.res)),
+  memo(std::move(o.memo)) { }
+matcher& matcher::operator=(matcher&& o) {
+  literals = std::move(o.literals);
+  res = std::move(o.res);
+  memo = std::move(o.memo);
+  return *this;
+}
+matcher::~matcher() = default;
+
+matcher::matcher(const std::vector<const char*>& patterns) {
+  std::string combined;
+  for (const char* p : patterns) {
+    if (is_literal(p)) literals.emplace(p);
+    else if (has_backref(p)) res.emplace_back(new regex(p));
+    else {
+      regex{p}; // report errors for the pattern by itself
+      if (!combined.empty()) combined += '|';
+      combined += "(?:";
+      combined += p;
+      combined += ')';
+    }
+  }
+  if (!combined.empty())
+    res.emplace(res.begin(),new regex(combined));
+}
+
+bool matcher::match(interned name) const {
+  if (literals.count(name)) return true;
+  for (const auto& re : res)
+    if (boost::regex_match(name.str(),*re)) return true;
+  return false;
+}
+
+bool matcher::operator()(interned name) const {
+  if (empty()) return false;
+  if (res.empty()) return literals.count(name);
+  { std::shared_lock<std::shared_timed_mutex> lock(mx);
+    const auto it = memo.find(name);
+    if (it!=memo.end()) return it->second;
+  }
+  const bool m = match(name);
+  std::lock_guard<std::shared_timed_mutex> lock(mx);
+  memo.emplace(name,m);
+  return m;
+}
@@ -0,0 +1,153 @@
+#include "mc.hh"
+
+#include <algorithm>
+
+#include "error.hh"
+
+using ivanp::error;
+
+namespace {
+
+// split on spaces and tabs
+template <typename F>
+void split(string_view s, F&& f) {
+  const char *p = s.begin(), * const end = s.end();
+  for (;;) {
+    while (p!=end && (*p==' ' || *p=='\t')) ++p;
+    if (p==end) break;
+    const char* const head = p;
+    while (p!=end && *p!=' ' && *p!='\t') ++p;
+    f(string_view(head,p-head));
+  }
+}
+
+std::vector<string_view> words(string_view s) {
+  std::vector<string_view> v;
+  split(s,[&](string_view w){ v.push_back(w); });
+  return v;
+}
+
+// whether a+sep sorts before b+sep, comparing bytes
+bool less(string_view a, string_view b, char sep) noexcept {
+  const auto n = std::min(a.size(),b.size());
+  if (const int c = a.substr(0,n).compare(b.substr(0,n))) return c < 0;
+  if (a.size()==b.size()) return false;
+  return a.size() < b.size()
+    ? (unsigned char)sep < (unsigned char)b[n]
+    : (unsigned char)a[n] < (unsigned char)sep;
+}
+
+}
+
+mc_rules::mc_rules(const char* fname)
+: src(std::make_shared<const input_buffer>(fname)) {
+  auto data = src->view();
+  unsigned line_n = 0;
+  for (string_view line; getline(data,line); ) {
+    ++line_n;
+    const auto w = words(line);
+    if (w.empty() || w[0][0]=='#') continue;
+    try {
+      if (w[0]=="bins") {
+        if (w.size() < 4) throw error(
+          "bins takes a variable and at least 2 edges");
+        bins[interned(w[1])].assign(w.begin()+2,w.end());
+      } else if (w[0]=="reverse") {
+        if (w.size()!=2) throw error("reverse takes a variable");
+        reverse.emplace(w[1]);
+      } else throw error("unknown rule \"",w[0],'\"');
+    } catch (const std::exception& e) {
+      throw error(fname,": line ",line_n,": ",e.what());
+    }
+  }
+}
+
+void read_mc(
+  const std::shared_ptr<const input_buffer>& buf, dataset& vars,
+  const mc_rules& rules, const var_filter& select
+) {
+  arena::scope scope;
+
+  struct field { string_view gen, values; unsigned line_n; };
+  struct var { interned name; string_view bins; std::vector<field> fields; };
+  std::vector<var> found;
+  std::unordered_map<interned,size_t> index; // into found
+  static constexpr size_t skip = -1;
+
+  auto data = buf->view();
+  unsigned line_n = 0;
+  for (string_view line; getline(data,line); ) {
+    ++line_n;
+    const auto d1 = line.find('.');
+    if (d1==string_view::npos) continue;
+    const auto d2 = line.find('.',d1+1);
+    if (d2==string_view::npos) continue;
+    const auto d3 = line.find(':',d2+1);
+    if (d3==string_view::npos) continue;
+    const auto kind = line.substr(d2+1,d3-d2-1);
+    const bool is_bins = (kind=="bins");
+    if (!is_bins && kind!="fid") continue;
+    const auto values = line.substr(d3+1);
+    if (values.find_first_not_of(" \t")==string_view::npos) continue;
+
+    const auto gen = line.substr(0,d1);
+    const auto name = line.substr(d1+1,d2-d1-1);
+    const interned id(name);
+    auto it = index.find(id);
+    if (it==index.end()) {
+      const bool selected = !select || select(name);
+      it = index.emplace(id, selected ? found.size() : skip).first;
+      if (selected) found.push_back({ id, { }, { } });
+    }
+    if (it->second==skip) continue;
+    auto& v = found[it->second];
+
+    if (!is_bins) v.fields.push_back({ gen, values, line_n });
+    else if (v.bins.empty()) v.bins = values;
+    else if (words(v.bins)!=words(values)) throw error(
+      "line ",line_n,": different bins for \"",name,"\" from ",gen);
+  }
+
+  std::sort(found.begin(),found.end(),[](const var& a, const var& b){
+    return less(a.name.str(),b.name.str(),'.');
+  });
+  for (auto& v : found) {
+    auto& x = vars[v.name];
+    if (!x.bin_edges.empty()) throw error(
+      "repeated binning for variable \"",v.name,'\"');
+    const auto rb = rules.bins.find(v.name);
+    if (rb!=rules.bins.end()) {
+      for (auto e : rb->second) x.bin_edges.push_back(e);
+      x.bin_edges.src = rules.src;
+    } else {
+      split(v.bins,[&](string_view e){ x.bin_edges.push_back(e); });
+      x.bin_edges.src = buf;
+    }
+
+    // the same generator can only repeat identical values
+    auto& fields = v.fields;
+    std::stable_sort(fields.begin(),fields.end(),
+      [](const field& a, const field& b){ return less(a.gen,b.gen,':'); });
+    fields.erase( std::unique(fields.begin(),fields.end(),
+      [&](const field& a, const field& b){
+        if (a.gen!=b.gen) return false;
+        if (words(a.values)!=words(b.values)) throw error(
+          "line ",b.line_n,": repeated generator ",b.gen," for \"",v.name,'\"');
+        return true;
+      }), fields.end() );
+
+    const bool reverse = rules.reverse.count(v.name);
+    for (const auto& f : fields) {
+      x.vals.emplace(f.gen);
+      auto& col = x.vals.back().second;
+      col.src = buf;
+      if (!x.bin_edges.empty()) col.reserve(x.bin_edges.size()-1);
+      split(f.values,[&](string_view s){ col.push_back(s); });
+      if (reverse) {
+        std::reverse(col.x.begin(),col.x.end());
+        std::reverse(col.x2.begin(),col.x2.end());
+        std::reverse(col.text.begin(),col.text.end());
+      }
+    }
+  }
+}
@@ -0,0 +1,133 @@
+#include "numconv.hh"
+
+#include <cmath>
+#include <cctype>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cstdint>
+#include <string>
+#ifdef __GLIBC__
+#include <locale.h>
+#endif
+
+namespace ivanp {
+
+namespace {
+
+constexpr double pow10[] = {
+  1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10,
+  1e11, 1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20,
+  1e21, 1e22
+};
+
+bool strtod_c(string_view str, double& x) noexcept {
+  // strtod would skip leading whitespace
+  if (str.empty() || std::isspace((unsigned char)str[0])) return false;
+  char buf[64];
+  std::string long_str;
+  const char* s = buf;
+  if (str.size() < sizeof(buf)) {
+    memcpy(buf,str.data(),str.size());
+    buf[str.size()] = '\0';
+  } else {
+    try { s = (long_str = std::string(str)).c_str(); }
+    catch (...) { return false; }
+  }
+  char* end;
+#ifdef __GLIBC__
+  static const locale_t c_locale = newlocale(LC_ALL_MASK,"C",nullptr);
+  x = strtod_l(s,&end,c_locale);
+#else
+  x = std::strtod(s,&end);
+#endif
+  return end==s+str.size();
+}
+
+template <typename... T>
+size_t print(char* buf, size_t size, const char* fmt, T... args) noexcept {
+  const int n = snprintf(buf,size,fmt,args...);
+  return n < 0 ? 0 : n;
+}
+
+}
+
+bool stod(string_view str, double& x) noexcept {
+  // fast path: decimal with at most 19 significant digits
+  // that is exact as a double, scaled by an exact power of 10
+  const char *p = str.begin(), * const end = str.end();
+  if (p==end) return false;
+  const bool neg = (*p=='-');
+  if (neg || *p=='+') ++p;
+  uint64_t m = 0;
+  int nd = 0, e = 0, ndigits = 0;
+  bool exact = true;
+  auto digit = [&](char c, bool frac){
+    ++ndigits;
+    if (nd==0 && c=='0') { if (frac) --e; return; } // leading zeros
+    if (nd<19) m = m*10 + (c-'0'), ++nd, e -= frac;
+    else {
+      if (!frac) ++e;
+      if (c!='0') exact = false;
+    }
+  };
+  for (; p!=end && unsigned(*p-'0')<10; ++p) digit(*p,false);
+  if (p!=end && *p=='.')
+    for (++p; p!=end && unsigned(*p-'0')<10; ++p) digit(*p,true);
+  if (!ndigits) return strtod_c(str,x); // inf, nan, etc.
+  if (p!=end && (*p=='e' || *p=='E')) {
+    ++p;
+    const bool eneg = (p!=end && *p=='-');
+    if (p!=end && (eneg || *p=='+')) ++p;
+    if (p==end) return false;
+    int ee = 0;
+    for (; p!=end && unsigned(*p-'0')<10; ++p)
+      if (ee < 10000) ee = ee*10 + (*p-'0');
+    e += eneg ? -ee : ee;
+  }
+  if (p!=end) return strtod_c(str,x);
+  if (m == 0) { x = neg ? -0. : 0.; return true; }
+  if (!exact || m > (uint64_t(1)<<53) || e < -22 || e > 22)
+    return strtod_c(str,x);
+  x = e<0 ? double(m)/pow10[-e] : double(m)*pow10[e];
+  if (neg) x = -x;
+  return true;
+}
+
+size_t dtos(double x, unsigned prec, char* buf, size_t size) noexcept {
+  if (prec==dtos_shortest) {
+    for (int p=15; ; ++p) {
+      const size_t n = print(buf,size,"%.*g",p,x);
+      double y;
+      if (p==17 || n>=size || (stod({buf,n},y) && y==x)) return n;
+    }
+  }
+  if (prec > 17) return print(buf,size,"%.*f",prec,x);
+  const double y = std::abs(x)*pow10[prec];
+  if (!(y < 1e18)) return print(buf,size,"%.*f",prec,x); // large, inf, nan
+
+  uint64_t n = y;
+  const double frac = y - n;
+  // the product is off by up to an ulp, so leave ties to printf
+  if (std::abs(frac-0.5) <= y*4.5e-16) return print(buf,size,"%.*f",prec,x);
+  if (frac > 0.5) ++n;
+
+  char digits[24];
+  unsigned nd = 0;
+  do digits[nd++] = '0' + n%10; while (n /= 10);
+  while (nd <= prec) digits[nd++] = '0';
+
+  const size_t len = std::signbit(x) + nd + (prec ? 1 : 0);
+  if (len >= size) return len;
+  char* s = buf;
+  if (std::signbit(x)) *s++ = '-';
+  for (unsigned i=nd; i>prec; ) *s++ = digits[--i];
+  if (prec) {
+    *s++ = '.';
+    for (unsigned i=prec; i; ) *s++ = digits[--i];
+  }
+  *s = '\0';
+  return len;
+}
+
+}
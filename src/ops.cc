@@ -0,0 +1,201 @@
+#include "ops.hh"
+
+#include <cmath>
+#include <tuple>
+#include <memory>
+#include <algorithm>
+
+#include "matcher.hh"
+#include "math.hh"
+#include "error.hh"
+
+using ivanp::cat;
+using ivanp::error;
+using ivanp::math::sq;
+
+namespace {
+
+std::string list(const ops::strings& v) {
+  std::string str;
+  for (const char* s : v) str += ' ', str += s;
+  return str;
+}
+
+}
+
+namespace ops {
+
+void rm(plan& p, const strings& patterns) {
+  if (patterns.empty()) return;
+  p.field("rm"+list(patterns),
+    [m = std::make_shared<const matcher>(patterns)]
+    (plan::state&, interned name, column&){
+      return !(*m)(name);
+    });
+}
+
+void sym(plan& p) {
+  p.field("sym",
+    [](plan::state&, interned, column& col){
+      for (unsigned i=0, n=col.size(); i<n; ++i) {
+        auto& s = col.text[i];
+        if (s.empty()) continue;
+        const auto d = s.find(',');
+        if (d!=string_view::npos) {
+          if (!col.asym(i)) throw error(
+            "cannot interpret \"",s,"\" as double");
+          const bool pm1 = (s[0]=='+' || s[0]=='-');
+          const bool pm2 = (s[d+1]=='+' || s[d+1]=='-');
+          const double u1 = pm1 ? std::abs(col.x[i]) : col.x[i];
+          const double u2 = pm2 ? std::abs(col.x2[i]) : col.x2[i];
+          if (u1>u2) col.x[i] = u1, s = s.substr(pm1,d-pm1);
+          else       col.x[i] = u2, s = s.substr(d+1+pm2);
+          col.x2[i] = NAN;
+        } else if (s[0]=='-' || s[0]=='+') {
+          col.x[i] = std::abs(col.x[i]);
+          s.remove_prefix(1);
+        }
+      }
+      return true;
+    });
+}
+
+void add(plan& p, const char* sum, const strings& patterns,
+         bool quad, bool except) {
+  static const char* const names[] {
+    "add", "qadd", "add-except", "qadd-except" };
+  const interned sum_name(sum);
+  p.field(cat(names[quad+2*except],list(patterns)),
+    [m = std::make_shared<const matcher>(patterns), sum_name, quad, except]
+    (plan::state& s, interned name, column& col){
+      if ((*m)(name) == except) return true;
+      if (s.acc.empty()) s.acc.assign(s.nbins,0.);
+      for (unsigned i=0; i<s.nbins; ++i) {
+        const auto x = col.at(i);
+        s.acc[i] += (!quad ? x : x*x);
+      }
+      if (name!=sum_name) return false;
+      col.clear();
+      return true;
+    });
+  p.var(cat("store the sum as ",sum),
+    [sum_name, quad](plan::state& s){
+      if (s.acc.empty()) s.acc.assign(s.nbins,0.);
+      auto& sum = s.var.vals[sum_name];
+      sum.reserve(s.nbins);
+      for (double d : s.acc)
+        sum.push_back(!quad ? d : std::sqrt(d));
+    });
+}
+
+void top(plan& p, unsigned ntop, const char* name, const strings& exclude) {
+  if (!ntop) return;
+  p.var(
+    cat("top ",ntop,", rest in quadrature as ",name,
+        exclude.empty() ? "" : ", excluding",list(exclude)),
+    [ntop, name = interned(name),
+     exclude_match = std::make_shared<const matcher>(exclude)]
+    (plan::state& s){
+      auto& vals = s.var.vals;
+      const auto& xsec = static_cast<const ordered_map<column>&>(vals)
+        ["xsec"].values();
+      const auto nbins = s.nbins;
+      using iter = decltype(vals.begin());
+      // map iterator, impact metric
+      std::vector<std::tuple< iter, double >> fields;
+      fields.reserve(vals.size());
+      std::vector<interned> order; // preserve fields' order
+      order.reserve(ntop+1);
+      for (auto it=vals.begin(); it!=vals.end(); ++it) {
+        // exclude accordingly specified fields
+        if ((*exclude_match)(it->first) || it->first=="xsec") {
+          order.push_back(it->first);
+          continue;
+        }
+        fields.emplace_back(it,0.);
+        const auto& bins = it->second;
+        for (unsigned i=0; i<nbins; ++i)
+          // use sum of fractional uncertainties as impact metric
+          std::get<1>(fields.back()) += bins.at(i)/xsec[i];
+      }
+
+      // there may be fewer fields than ntop
+      const size_t n = std::min<size_t>(ntop,fields.size());
+
+      // select top contributions (descending)
+      std::partial_sort( fields.begin(), fields.begin()+n, fields.end(),
+        [](const auto& a, const auto& b){
+          return std::get<1>(a) > std::get<1>(b); });
+      // re-sort back minor contributions by order (backward)
+      std::sort( fields.begin()+n, fields.end(),
+        [](const auto& a, const auto& b){
+          return std::get<0>(a) > std::get<0>(b); });
+
+      // keep order of top contributions
+      for (size_t i=n; i; ) order.push_back(std::get<0>(fields[--i])->first);
+
+      // sum others in quadrature and erase contributions
+      std::vector<double> sumd(nbins,0.);
+      for (auto it=fields.begin()+n; it!=fields.end(); ++it) {
+        for (unsigned i=0; i<nbins; ++i)
+          sumd[i] += sq( std::get<0>(*it)->second.x[i] );
+        vals.erase(std::get<0>(*it));
+      }
+
+      // apply order
+      vals.sort([
+          f = [&order](interned name){
+            return std::find(order.begin(),order.end(),name);
+          }
+        ](const auto& a, const auto& b){
+          return f(a.first) < f(b.first);
+        });
+
+      // add others to vars
+      auto& sum = vals[name];
+      sum.reserve(nbins);
+      for (double d : sumd) sum.push_back(std::sqrt(d));
+    });
+}
+
+void order(plan& p, const strings& fields) {
+  if (fields.empty()) return;
+  p.var("order"+list(fields),
+    [ids = std::vector<interned>(fields.begin(),fields.end())]
+    (plan::state& s){
+      s.var.vals.sort([
+          f = [&ids](interned name){
+            return std::find(ids.begin(),ids.end(),name);
+          }
+        ](const auto& a, const auto& b){
+          return f(a.first) < f(b.first);
+        });
+    });
+}
+
+void join(dataset& to, dataset& from, boost::optional<double> tol,
+          const std::function<void(bool,interned,interned)>& report) {
+  for (auto& var2 : from) {
+    if (!to.count(var2.first)) throw error(
+      "variable \"",var2.first,"\" is not in the data joined to");
+    auto& var1 = to[var2.first];
+
+    const auto& b1 = var1.bin_edges.values();
+    const auto& b2 = var2.second.bin_edges.values();
+    bool same = b1.size()==b2.size();
+    for (unsigned i=0, n=b1.size(); same && i<n; ++i) {
+      const auto x1 = b1[i], x2 = b2[i];
+      same = (x1==x2) || (tol && std::abs(1.-x1/x2) < *tol);
+    }
+    if (!same) throw error("different binning for \"",var2.first,'\"');
+
+    for (auto&& val2 : var2.second.vals) {
+      auto& val1 = var1.vals[val2.first];
+      if (report) report(val1.empty(),var2.first,val2.first);
+      val1 = std::move(val2.second);
+    }
+  }
+  from.clear();
+}
+
+}
@@ -0,0 +1,391 @@
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <deque>
+#include <sstream>
+#include <unordered_map>
+#include <unordered_set>
+#include <algorithm>
+#include <future>
+#include <mutex>
+#include <cstdio>
+#include <cmath>
+
+#include "termcolor.hpp"
+
+#include "reader.hh"
+#include "hepdata.hh"
+#include "mc.hh"
+#include "program_options.hh"
+#include "edit_options.hh"
+#include "ops.hh"
+#include "numconv.hh"
+#include "error.hh"
+
+using std::cout;
+using std::cerr;
+using std::endl;
+namespace tc = termcolor;
+using ivanp::error;
+
+#define STR_IMPL(x) #x
+#define STR(x) STR_IMPL(x)
+
+std::ostream& operator<<(std::ostream& out, const std::exception& e) {
+  return out << tc::red << e.what() << tc::reset;
+}
+
+namespace {
+
+std::mutex cerr_mx;
+
+// A step of the pipeline, or a source of data for one
+struct node {
+  enum kind_t { step, hepdata, mc, file, command } kind;
+  std::string name; // target, file name, or command
+  std::vector<node*> inputs; // or targets used by the command or mc
+  std::vector<std::string> args; // step options
+  edit_options opts;
+  bool bin = false;
+  plan steps;
+
+  bool needed = false, write = false;
+  unsigned nusers = 0; // steps yet to take the data
+  std::mutex mx;
+  dataset data;
+  std::vector<interned> vars; // of a step, set before it is done
+  std::shared_future<void> done;
+
+  node(kind_t kind, std::string name): kind(kind), name(std::move(name)) { }
+
+  // a copy for all but the last user
+  dataset take() {
+    std::lock_guard<std::mutex> lock(mx);
+    if (--nusers) return data;
+    return std::move(data);
+  }
+};
+
+// Gives computed cells the text they would be written with,
+// so that steps see the same data as if it was written and read back.
+void settle(column& col, unsigned prec) {
+  if (std::all_of(col.x2.begin(),col.x2.end(),
+        [](double x){ return std::isnan(x); }))
+    col.x2.clear();
+  if (std::none_of(col.text.begin(),col.text.end(),
+        [](string_view s){ return s.empty(); }))
+    return;
+
+  std::string str;
+  std::vector<size_t> ends;
+  ends.reserve(col.size());
+  char buf[ivanp::dtos_size];
+  for (size_t i=0, n=col.size(); i<n; ++i) {
+    const auto s = col.text[i];
+    if (!s.empty()) str.append(s.data(),s.size());
+    else {
+      const size_t len = ivanp::dtos(col.x[i],prec,buf,sizeof(buf));
+      if (len < sizeof(buf)) str.append(buf,len);
+      else {
+        const size_t m = str.size();
+        str.resize(m+len+1);
+        ivanp::dtos(col.x[i],prec,&str[m],len+1);
+        str.resize(m+len);
+      }
+    }
+    ends.push_back(str.size());
+  }
+
+  col.src = std::make_shared<const input_buffer>(std::move(str));
+  const auto text = col.src->view();
+  for (size_t i=0, n=col.size(), first=0; i<n; first=ends[i++]) {
+    const bool computed = col.text[i].empty();
+    col.text[i] = text.substr(first,ends[i]-first);
+    if (computed && !ivanp::stod(col.text[i],col.x[i])) col.x[i] = NAN;
+  }
+}
+void settle(dataset& data, unsigned prec) {
+  for (auto& var : data) {
+    settle(var.second.bin_edges,prec);
+    for (auto& v : var.second.vals) settle(v.second,prec);
+  }
+}
+
+void run(node& n, unsigned njobs, const mc_rules& rules) {
+  switch (n.kind) {
+    case node::hepdata:
+      read_hepdata(
+        std::make_shared<const input_buffer>(n.name.c_str()), n.data,
+        [&](unsigned line_n, string_view var_name){
+          std::lock_guard<std::mutex> lock(cerr_mx);
+          cerr << tc::yellow << n.name << ": Line " << line_n
+               << ": repeated variable:" << tc::reset << " "
+               << var_name << endl;
+        });
+      break;
+    case node::mc: { // only the variables of the target after '@'
+      std::unordered_set<interned> vars;
+      for (const auto* in : n.inputs)
+        vars.insert(in->vars.begin(),in->vars.end());
+      read_mc(
+        std::make_shared<const input_buffer>(
+          n.name.substr(0,n.name.find('@')).c_str()),
+        n.data, rules,
+        n.inputs.empty() ? var_filter() : [&](string_view name){
+          interned id;
+          return interned::find(name,id) && vars.count(id);
+        });
+    } break;
+    case node::file:
+      n.data.load(n.name.c_str());
+      break;
+    case node::command: {
+      FILE* pipe = ::popen(n.name.c_str(),"r");
+      if (!pipe) throw error("cannot run command");
+      std::string str;
+      char block[1<<16];
+      for (size_t m; (m = fread(block,1,sizeof(block),pipe)); )
+        str.append(block,m);
+      if (::pclose(pipe)) throw error("command failed");
+      n.data.load(std::make_shared<const input_buffer>(std::move(str)));
+    } break;
+    case node::step: {
+      n.data = n.inputs.front()->take();
+      for (auto it=n.inputs.begin()+1; it!=n.inputs.end(); ++it) {
+        auto more = (*it)->take();
+        try {
+          ops::join(n.data,more,n.opts.tol);
+        } catch (const std::exception& e) {
+          throw error(e.what()," in ",(*it)->name);
+        }
+      }
+      n.data.check();
+      if (!n.steps.empty()) n.steps(n.data,njobs);
+      settle(n.data,n.opts.prec);
+      for (const auto& var : n.data) n.vars.push_back(var.first);
+      if (n.write) {
+        std::ofstream out(n.name);
+        n.data.write(out,n.bin,n.opts.prec);
+        if (!out) throw error("cannot write file");
+      }
+    } break;
+  }
+}
+
+}
+
+int main(int argc, char* argv[]) {
+  const char* pfname = nullptr;
+  std::vector<const char*> targets;
+  const char* rfname = STR(CONFIG) "/mc_rules.txt";
+  unsigned njobs = 1;
+  bool explain = false;
+
+  try {
+    using namespace ivanp::po;
+    if (program_options()
+      (pfname,'p',"pipeline file",pos(1),req())
+      (targets,'t',"targets to write\n"
+        "default is the ones not used by other steps",pos())
+      (njobs,'j',"process the variables of a step on this many threads\n"
+        "0 to use all cores, default is 1\n"
+        "independent steps always run concurrently")
+      (rfname,'r',"corrections to MC predictions\n"
+        "default is config/mc_rules.txt")
+      (explain,"--explain","print the steps to run and exit")
+      .parse(argc,argv)) return 0;
+  } catch (const std::exception& e) {
+    cerr << e << endl;
+    return 1;
+  }
+
+  // PARSE ==========================================================
+  std::deque<node> nodes;
+  std::unordered_map<std::string,node*> names;
+  try {
+    std::ifstream f(pfname);
+    if (!f) throw error("cannot open file ",pfname);
+    unsigned line_n = 0;
+    for (std::string line, more; std::getline(f,line); ) {
+      const unsigned first_n = ++line_n;
+      while (!line.empty() && line.back()=='\\' && std::getline(f,more)) {
+        ++line_n;
+        line.back() = ' ';
+        line += more;
+      }
+      try {
+        const auto is_space = [](char c){ return c==' ' || c=='\t'; };
+        const auto skip = [&](size_t i){
+          while (i<line.size() && is_space(line[i])) ++i;
+          return i;
+        };
+        size_t i = skip(0);
+        if (i==line.size() || line[i]=='#') continue;
+
+        const auto colon = line.find(':',i);
+        if (colon==std::string::npos) throw error("expected \':\'");
+        size_t end = colon;
+        while (end>i && is_space(line[end-1])) --end;
+        std::string target = line.substr(i,end-i);
+        if (target.empty()) throw error("missing target");
+
+        // inputs, added before the step as nodes come after their inputs
+        std::vector<node*> inputs;
+        for (i=skip(colon+1); i<line.size() && line[i]!='|'; i=skip(i)) {
+          std::string name;
+          node::kind_t kind;
+          if (line[i]=='`') {
+            const auto close = line.find('`',i+1);
+            if (close==std::string::npos) throw error(
+              "missing closing \'`\'");
+            name = line.substr(i+1,close-i-1);
+            kind = node::command;
+            i = close+1;
+          } else {
+            const auto first = i;
+            while (i<line.size() && !is_space(line[i]) && line[i]!='|') ++i;
+            name = line.substr(first,i-first);
+            const string_view ext(".HepData");
+            kind = string_view(name).ends_with(ext) ? node::hepdata
+              : name.find('@')!=std::string::npos
+                || string_view(name).ends_with(".data") ? node::mc
+              : node::file;
+          }
+          auto& in = names[name];
+          if (!in) {
+            nodes.emplace_back(kind,name);
+            in = &nodes.back();
+            if (kind==node::command) { // depends on targets it names
+              std::istringstream words(name);
+              for (std::string w; words >> w; ) {
+                const auto it = names.find(w);
+                if (it!=names.end() && it->second->kind==node::step)
+                  in->inputs.push_back(it->second);
+              }
+            } else if (kind==node::mc) { // selects the variables of a target
+              const auto at = name.find('@');
+              if (at!=std::string::npos) {
+                const auto it = names.find(name.substr(at+1));
+                if (it==names.end() || it->second->kind!=node::step)
+                  throw error("no step for target \"",name.substr(at+1),'\"');
+                in->inputs.push_back(it->second);
+              }
+            }
+          }
+          inputs.push_back(in);
+        }
+        if (inputs.empty()) throw error("no inputs");
+        if (names.count(target)) throw error(
+          "\"",target,"\" is already an input or a target");
+        nodes.emplace_back(node::step,target);
+        auto& n = nodes.back();
+        n.inputs = std::move(inputs);
+        names.emplace(target,&n);
+
+        // options, parsed like those of edit
+        n.args.push_back(target);
+        for (i = skip(i+1); i<line.size(); i = skip(i)) {
+          const auto first = i;
+          while (i<line.size() && !is_space(line[i])) ++i;
+          n.args.push_back(line.substr(first,i-first));
+        }
+        std::vector<const char*> args;
+        for (const auto& a : n.args) args.push_back(a.c_str());
+        ivanp::po::program_options po;
+        n.opts.declare(po);
+        po(n.bin,"--bin","write output in binary format");
+        po.parse(args.size(),args.data(),false);
+        n.opts.check();
+        n.steps = n.opts.compile();
+      } catch (const std::exception& e) {
+        throw error(pfname,':',first_n,": ",e.what());
+      }
+    }
+
+    // select steps to run
+    if (targets.empty()) {
+      std::unordered_set<const node*> used;
+      for (const auto& n : nodes)
+        if (n.kind==node::step) used.insert(n.inputs.begin(),n.inputs.end());
+      for (const auto& n : nodes)
+        if (n.kind==node::step && !used.count(&n))
+          targets.push_back(n.name.c_str());
+    }
+    std::vector<node*> stack;
+    for (const char* t : targets) {
+      const auto it = names.find(t);
+      if (it==names.end() || it->second->kind!=node::step) throw error(
+        "no step for target \"",t,"\"");
+      it->second->write = true;
+      stack.push_back(it->second);
+    }
+    while (!stack.empty()) {
+      auto* n = stack.back();
+      stack.pop_back();
+      if (n->needed) continue;
+      n->needed = true;
+      for (auto* in : n->inputs) {
+        if (n->kind==node::command) in->write = true;
+        else if (n->kind==node::step) ++in->nusers;
+        stack.push_back(in);
+      }
+    }
+  } catch (const std::exception& e) {
+    cerr << e << endl;
+    return 1;
+  }
+
+  if (explain) {
+    for (const auto& n : nodes) {
+      if (!n.needed || n.kind!=node::step) continue;
+      cout << n.name << (n.write ? " (written)" : "") << " from";
+      for (const auto* in : n.inputs) {
+        if (in->kind==node::command) cout << " `" << in->name << '`';
+        else cout << ' ' << in->name;
+      }
+      cout << '\n' << n.steps;
+    }
+    if (njobs!=1) cout << "on " << njobs << " threads\n";
+    return 0;
+  }
+
+  // RUN ============================================================
+  mc_rules rules;
+  try {
+    if (std::any_of(nodes.begin(),nodes.end(),[](const node& n){
+          return n.needed && n.kind==node::mc; }))
+      rules = mc_rules(rfname);
+  } catch (const std::exception& e) {
+    cerr << e << endl;
+    return 1;
+  }
+
+  // nodes come after their inputs
+  for (auto& n : nodes) {
+    if (!n.needed) continue;
+    n.done = std::async(std::launch::async,[&n,njobs,&rules]{
+      for (auto* in : n.inputs) in->done.get();
+      try {
+        run(n,njobs,rules);
+      } catch (const std::exception& e) {
+        throw error(n.kind==node::command ? '`'+n.name+'`' : n.name,
+                    ": ",e.what());
+      }
+    }).share();
+  }
+  int status = 0;
+  for (auto& n : nodes) {
+    if (!n.needed) continue;
+    try {
+      n.done.get();
+    } catch (const std::exception& e) {
+      if (!status) {
+        std::lock_guard<std::mutex> lock(cerr_mx);
+        cerr << e << endl;
+      }
+      status = 1;
+    }
+  }
+  return status;
+}
@@ -0,0 +1,42 @@
+#include "plan.hh"
+#include "parallel.hh"
+
+void plan::operator()(var_t& var) const {
+  state s { var, unsigned(var.bin_edges.size()-1), { } };
+  if (!field_steps.empty()) {
+    auto& vals = var.vals;
+    auto last = vals.end();
+    for (auto it=vals.begin(); it!=last; ) {
+      bool keep = true;
+      for (const auto& step : field_steps)
+        if (!(keep = step.second(s,it->first,it->second))) break;
+      if (keep) ++it;
+      else {
+        it = vals.erase(it);
+        last = vals.end();
+      }
+    }
+  }
+  for (const auto& step : var_steps) step.second(s);
+}
+
+void plan::operator()(dataset& data, unsigned njobs) const {
+  std::vector<var_t*> vars;
+  vars.reserve(data.size());
+  for (auto& var : data) vars.push_back(&var.second);
+  ivanp::parallel_for(vars.size(),njobs,[&](size_t i){ (*this)(*vars[i]); });
+}
+
+std::ostream& operator<<(std::ostream& out, const plan& p) {
+  unsigned i = 0;
+  out << "for each variable:\n";
+  if (!p.field_steps.empty()) {
+    out << "  for each field, in one pass:\n";
+    for (const auto& step : p.field_steps)
+      out << "    " << ++i << ". " << step.first << '\n';
+  }
+  for (const auto& step : p.var_steps)
+    out << "  " << ++i << ". " << step.first << '\n';
+  if (!i) out << "  nothing\n";
+  return out;
+}
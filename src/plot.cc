@@ -1,8 +1,24 @@
 #include <array>
 #include <memory>
+#include <unordered_map>
 #include <cmath>
-
-#include <boost/lexical_cast.hpp>
+#include <thread>
+#include <algorithm>
+#include <tuple>
+
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <cstdlib>
+
+#include <unistd.h>
+#include <sys/stat.h>
+#include <dirent.h>
+#include <climits>
+#include <csignal>
+#include <spawn.h>
+#include <sys/wait.h>
+#include <fcntl.h>
 
 #include <TCanvas.h>
 #include <TAxis.h>
@@ -14,8 +30,13 @@
 #include "termcolor.hpp"
 
 #include "reader.hh"
+#include "binary.hh"
 #include "program_options.hh"
 #include "math.hh"
+#include "numconv.hh"
+#include "bands.hh"
+#include "svg.hh"
+#include "serve.hh"
 
 #define TEST(var) \
   std::cerr << tc::cyan << #var << tc::reset << " = " << var << std::endl;
@@ -34,38 +55,227 @@ std::ostream& operator<<(std::ostream& out, const std::exception& e) {
   return out << tc::red << e.what() << tc::reset;
 }
 
-double stod(const std::string& str) {
-  try {
-    return boost::lexical_cast<double>(str);
-  } catch (const boost::bad_lexical_cast& e) {
-    throw ivanp::error("cannot interpret \"",str,"\" as double");
+// Parsed config files are kept between jobs in --serve mode,
+// until the file changes.
+template <typename T>
+const T& cached(const char* fname, T(*parse)(const char*)) {
+  static std::unordered_map<std::string,std::pair<timespec,T>> cache;
+  std::string key;
+  if (fname) {
+    if (fname[0]!='/') {
+      char cwd[PATH_MAX];
+      if (getcwd(cwd,sizeof(cwd))) key = cat(cwd,'/');
+    }
+    key += fname;
+  }
+  auto& entry = cache[key];
+  struct stat st;
+  if (!fname || ::stat(fname,&st)) { // not cached
+    entry.second = parse(fname);
+    entry.first = { };
+  } else if (st.st_mtim.tv_sec !=entry.first.tv_sec ||
+             st.st_mtim.tv_nsec!=entry.first.tv_nsec) {
+    entry.second = parse(fname);
+    entry.first = st.st_mtim;
+  }
+  return entry.second;
+}
+
+using replacements = std::unordered_map<std::string,std::string>;
+replacements read_replacements(const char* fname) {
+  replacements map;
+  std::ifstream f(fname);
+  for (std::string line; std::getline(f,line); ) {
+    if (line.empty() || line[0]=='#') continue;
+    const auto d1 = line.find(' ');
+    const auto d2 = line.find_first_not_of(' ',d1);
+    map.emplace(line.substr(0,d1),line.substr(d2));
   }
+  return map;
+}
+auto make_replacer(const char* fname) {
+  return [&map = cached(fname,read_replacements)](const std::string& name){
+    const auto it = map.find(name);
+    return it!=map.end() ? it->second : name;
+  };
 }
 
-template <typename V, typename F>
-auto operator|(const V& v, F&& f) {
-  std::vector<decltype(f(*v.begin()))> out;
-  out.reserve(v.size());
-  for (const auto& x : v) out.emplace_back(f(x));
-  return out;
+struct style_t {
+  Color_t fill_color, line_color;
+  Style_t line_style;
+  style_t(const std::string& s) {
+    std::stringstream(s) >> fill_color >> line_color >> line_style;
+  }
+};
+std::vector<style_t> read_styles(const char* fname) {
+  std::vector<style_t> styles;
+  std::ifstream f(fname);
+  for (std::string line; std::getline(f,line); ) {
+    if (line.empty() || line[0]=='#') continue;
+    styles.emplace_back(line);
+  }
+  return styles;
 }
 
-auto make_replacer(const char* filename) {
-  std::unordered_map<std::string,std::string> map;
-  std::ifstream f(filename);
+// throws the bad line
+std::unordered_map<std::string,double> read_ranges(const char* fname) {
+  std::unordered_map<std::string,double> ranges;
+  if (!fname) return ranges;
+  std::ifstream f(fname);
   for (std::string line; std::getline(f,line); ) {
     if (line.empty() || line[0]=='#') continue;
     const auto d1 = line.find(' ');
     const auto d2 = line.find_first_not_of(' ',d1);
-    map.emplace(line.substr(0,d1),line.substr(d2));
+    double max;
+    if (!ivanp::stod(view(line,d2),max)) throw ivanp::error(line);
+    ranges.emplace(line.substr(0,d1),max);
+  }
+  return ranges;
+}
+
+// FNV-1a hash of the bytes of values
+struct fnv1a {
+  uint64_t value = 0xcbf29ce484222325;
+  void operator()(const void* p, size_t n) noexcept {
+    for (const char *c = static_cast<const char*>(p), *end = c+n; c!=end; ++c)
+      value = (value ^ static_cast<unsigned char>(*c)) * 0x100000001b3;
+  }
+  template <typename T>
+  std::enable_if_t<std::is_arithmetic<T>::value> operator()(T x) noexcept {
+    (*this)(&x,sizeof(x));
+  }
+  template <typename T, size_t N>
+  void operator()(const std::array<T,N>& a) noexcept {
+    (*this)(a.data(),sizeof(T)*N);
+  }
+  template <typename T, typename A>
+  void operator()(const std::vector<T,A>& v) noexcept {
+    (*this)(v.size());
+    (*this)(v.data(),sizeof(T)*v.size());
   }
-  return [map=std::move(map)](const std::string& name){
-    try { return map.at(name); }
-    catch (...) { return name; }
+  void operator()(string_view s) noexcept {
+    (*this)(s.size());
+    (*this)(s.data(),s.size());
+  }
+  void operator()(const std::string& s) noexcept { (*this)(string_view(s)); }
+  void operator()(const char* s) noexcept { (*this)(string_view(s)); }
+};
+
+// Remove the least recently used pages while the cache is over max bytes,
+// sparing the ones in keep.
+void prune_cache(const char* dir, uint64_t max,
+                 const std::vector<std::string>& keep) {
+  DIR* d = ::opendir(dir);
+  if (!d) return;
+  struct file { std::string name; timespec used; uint64_t size; };
+  std::vector<file> files;
+  uint64_t total = 0;
+  while (const dirent* e = ::readdir(d)) {
+    if (e->d_name[0]=='.' || strstr(e->d_name,".part")) continue;
+    auto name = cat(dir,'/',e->d_name);
+    struct stat st;
+    if (::stat(name.c_str(),&st) || !S_ISREG(st.st_mode)) continue;
+    total += st.st_size;
+    if (std::find(keep.begin(),keep.end(),name)==keep.end())
+      files.push_back({ std::move(name), st.st_mtim, uint64_t(st.st_size) });
+  }
+  ::closedir(d);
+  std::sort(files.begin(),files.end(),[](const file& a, const file& b){
+    return std::tie(a.used.tv_sec,a.used.tv_nsec)
+         < std::tie(b.used.tv_sec,b.used.tv_nsec);
+  });
+  for (auto it=files.begin(); total>max && it!=files.end(); ++it)
+    if (!::unlink(it->name.c_str())) total -= it->size;
+}
+
+// run a command, true if it succeeded
+bool run(std::vector<std::string> args) {
+  std::vector<char*> argv;
+  argv.reserve(args.size()+1);
+  for (auto& arg : args) argv.push_back(&arg[0]);
+  argv.push_back(nullptr);
+  pid_t pid;
+  if (posix_spawnp(&pid,argv[0],nullptr,nullptr,argv.data(),environ))
+    return false;
+  int status;
+  return waitpid(pid,&status,0)==pid
+      && WIFEXITED(status) && WEXITSTATUS(status)==0;
+}
+
+bool merge_pdf(const std::vector<std::string>& pages, const std::string& out) {
+  std::vector<std::string> args { "pdfunite" };
+  args.insert(args.end(),pages.begin(),pages.end());
+  args.push_back(out);
+  if (run(args)) return true;
+  args = { "gs", "-q", "-dNOPAUSE", "-dBATCH", "-dSAFER",
+           "-sDEVICE=pdfwrite", "-sOutputFile="+out };
+  args.insert(args.end(),pages.begin(),pages.end());
+  return run(args);
+}
+
+// write stacked bands of all pages as json or csv
+template <typename Pages, typename Stack>
+void emit_text(std::ostream& out, bool json,
+               const Pages& pages, const Stack& stack) {
+  char buf[dtos_size];
+  const auto num = [&](double x) -> std::ostream& {
+    if (json && !std::isfinite(x)) return out << "null";
+    const size_t len = dtos(x,dtos_shortest,buf,sizeof(buf));
+    return len < sizeof(buf) ? out.write(buf,len) : out << x;
   };
+  const auto str = [&](const std::string& s) -> std::ostream& {
+    if (!json) return out << s;
+    out << '"';
+    for (char c : s) {
+      if (c=='"' || c=='\\') out << '\\';
+      out << c;
+    }
+    return out << '"';
+  };
+
+  if (json) out << '{';
+  else out << "var,band,low,high,value,range\n";
+  bool first_var = true;
+  for (const auto& page : pages) {
+    const auto s = stack(page);
+    if (json) {
+      if (!first_var) out << ',';
+      first_var = false;
+      out << "\n";
+      str(page.name) << ":{\"bins\":[";
+      for (size_t j=0; j<=s.nbins; ++j) {
+        if (j) out << ',';
+        num(s.bins[j]);
+      }
+      out << "],\"range\":";
+      num(s.max) << ",\"bands\":[";
+    }
+    for (size_t i=0; i<s.names.size(); ++i) {
+      const double* row = s.m.data() + i*s.nbins;
+      if (json) {
+        out << (i ? ",\n  {" : "\n  {") << "\"name\":";
+        str(*s.names[i]) << ",\"values\":[";
+        for (size_t j=0; j<s.nbins; ++j) {
+          if (j) out << ',';
+          num(row[j]);
+        }
+        out << "]}";
+      } else for (size_t j=0; j<s.nbins; ++j) {
+        str(page.name) << ',';
+        str(*s.names[i]) << ',';
+        num(s.bins[j]) << ',';
+        num(s.bins[j+1]) << ',';
+        num(row[j]) << ',';
+        num(s.max) << '\n';
+      }
+    }
+    if (json) out << "]}";
+  }
+  if (json) out << "\n}\n";
 }
 
-int main(int argc, char* argv[]) {
+// one invocation, canv is kept between jobs in --serve mode
+int run(int argc, char* argv[], std::unique_ptr<TCanvas>& canv) {
   std::string ofname;
   const char *ifname,
              *vars_tex = STR(CONFIG) "/vars.tex",
@@ -73,9 +283,15 @@ int main(int argc, char* argv[]) {
              *style_file = STR(CONFIG) "/blue.sty",
              *ylabel = "",
              *ranges_file = nullptr;
+  std::vector<std::string> only_vars;
   std::array<float,4> margins { 0.1, 0.035, 0.13, 0.03 };
   float yoffset = 0.7;
   bool burst = false;
+  unsigned njobs = 1;
+  const char* cache_dir = nullptr;
+  unsigned cache_mb = 256;
+  const char* emit = nullptr;
+  const char* serve_path = nullptr;
 
   try {
     using namespace ivanp::po;
@@ -83,6 +299,7 @@ int main(int argc, char* argv[]) {
       (ifname,'i',"input file name",req(),pos())
       (ofname,'o',"output file name",req())
       (burst,"--burst","put each plot in it's own file")
+      (only_vars,"--var","plot only these variables")
       (style_file,{"-s","--style"},"style file "+cat('[',style_file,']'))
       (vars_tex,"--vars-tex","file with latex for variables' names\n"+
         cat("default: ",vars_tex))
@@ -96,7 +313,27 @@ int main(int argc, char* argv[]) {
             "t[",std::get<3>(margins),"]"))
       (ylabel,'y',"Y-axis label")
       (yoffset,"--y-offset","Y-axis label offset "+cat('[',yoffset,']'))
+      (njobs,'j',"render on this many processes\n"
+        "0 to use all cores, default is 1\n"
+        "without --burst, pages are merged with pdfunite or gs")
+      (emit,"--emit","write the bands as json, csv or bin, don't plot\n"
+        "-o - writes to stdout")
+      (cache_dir,"--cache","reuse pages rendered from unchanged input\n"
+        "kept in this directory")
+      (cache_mb,"--cache-size","MB of pages the cache keeps "+
+        cat('[',cache_mb,"]\n")+"least recently used ones are removed")
+      (serve_path,"--serve","keep running, taking jobs from plotc\n"
+        "must be the only option, with an optional socket path\n"
+        "default: $PLOT_SOCKET, or plot.sock in $XDG_RUNTIME_DIR\n"
+        "or in /tmp/plot-UID")
       .parse(argc,argv,true)) return 0;
+
+    if (serve_path) throw ivanp::error("--serve must be the only option");
+    if (emit && strcmp(emit,"json") && strcmp(emit,"csv")
+             && strcmp(emit,"bin")) throw ivanp::error(
+      "--emit takes json, csv or bin");
+    if ((njobs!=1 || cache_dir) && !emit && !burst && !ends_with(ofname,".pdf"))
+      throw ivanp::error("-j or --cache without --burst requires .pdf output");
   } catch (const std::exception& e) {
     cerr << e << endl;
     return 1;
@@ -106,67 +343,189 @@ int main(int argc, char* argv[]) {
   const auto var_name = make_replacer(vars_tex);
   const auto unc_name = make_replacer(unc_tex);
 
-  struct style_t {
-    Color_t fill_color, line_color;
-    Style_t line_style;
-    style_t(const std::string& s) {
-      std::stringstream(s) >> fill_color >> line_color >> line_style;
-    }
-  };
-  std::vector<style_t> styles;
-  { std::ifstream f(style_file);
-    for (std::string line; std::getline(f,line); ) {
-      if (line.empty() || line[0]=='#') continue;
-      styles.emplace_back(line);
-    }
-  }
+  const auto& styles = cached(style_file,read_styles);
   if (styles.empty()) {
     cerr << tc::red << "empty file:" << tc::reset << ' ' << style_file << endl;
     return 1;
   }
-  auto style = [&styles,i=0u](TH1* h) mutable {
-    if (i==styles.size()) i = 0u;
-    h->SetFillColor(styles[i].fill_color);
-    h->SetLineColor(styles[i].line_color);
-    h->SetLineStyle(styles[i].line_style);
-    ++i;
-  };
 
-  std::unordered_map<std::string,double> ranges;
-  { std::ifstream f(ranges_file);
-    for (std::string line; std::getline(f,line); ) {
-      if (line.empty() || line[0]=='#') continue;
-      const auto d1 = line.find(' ');
-      const auto d2 = line.find_first_not_of(' ',d1);
-      ranges.emplace(line.substr(0,d1),::stod(line.substr(d2)));
-    }
+  const std::unordered_map<std::string,double>* ranges_ptr;
+  try {
+    ranges_ptr = &cached(ranges_file,read_ranges);
+  } catch (const std::exception& e) {
+    cerr << tc::red << "bad range:" << tc::reset << ' ' << e.what() << endl;
+    return 1;
   }
+  const auto& ranges = *ranges_ptr;
 
   // ================================================================
   // read input file
-  std::ifstream(ifname) >> var_t::all;
+  dataset data;
+  try {
+    data.load(ifname, only_vars.empty() ? var_filter{} :
+      [&](string_view name){
+        return std::find(only_vars.begin(),only_vars.end(),name)
+          != only_vars.end();
+      });
+  } catch (const std::exception& e) {
+    cerr << e << endl;
+    return 1;
+  }
+
+  // the canvas is made when first needed, and may be kept between jobs
+  auto canvas = [&](std::unique_ptr<TCanvas>& canv) -> TCanvas& {
+    if (!canv) canv = std::make_unique<TCanvas>();
+    canv->cd();
+    canv->SetMargin(std::get<0>(margins),std::get<1>(margins),
+                    std::get<2>(margins),std::get<3>(margins));
+    gPad->SetTickx();
+    gPad->SetTicky();
+    return *canv;
+  };
+
+  // each variable's first style continues from the previous one
+  struct page_t {
+    const std::string& name;
+    const var_t& var;
+    unsigned style;
+  };
+  std::vector<page_t> pages;
+  pages.reserve(data.size());
+  for (const auto& var : data) {
+    const unsigned i = pages.empty() ? 0 : (
+      pages.back().style + pages.back().var.vals.size()-1 ) % styles.size();
+    pages.push_back({var.first,var.second,i});
+  }
+
+  const auto ext = [&]{
+    const auto d = ofname.rfind('.');
+    return d==std::string::npos || ofname.find('/',d)!=std::string::npos
+      ? std::string() : ofname.substr(d);
+  }();
+  const auto burst_name = [&](const std::string& var){
+    return cat(ofname.substr(0,ofname.size()-ext.size()),'_',var,ext);
+  };
+  if (!emit && !burst && ext==".svg" && pages.size()>1) {
+    cerr << tc::red << "svg holds a single page, use --burst" << tc::reset
+         << endl;
+    return 1;
+  }
+
+  // cumulative bands relative to xsec, and the Y range ---------------
+  using stack_t = band_stack;
+  const auto stack = [&](const page_t& page) {
+    auto s = stack_bands(page.var);
+    const auto it = ranges.find(page.name);
+    if (it!=ranges.end()) s.max = it->second;
+    else s.max *= 1.65;
+    return s;
+  };
+
+  if (emit) { // EMIT =================================================
+    std::ofstream fout;
+    if (ofname!="-") fout.open(ofname);
+    std::ostream& out = ofname!="-" ? fout : cout;
+    try {
+      if (!strcmp(emit,"bin")) {
+        dataset bands;
+        for (const auto& page : pages) {
+          const auto s = stack(page);
+          auto& var = bands[page.name];
+          var.bin_edges = page.var.bin_edges;
+          for (size_t i=0; i<s.names.size(); ++i) {
+            var.vals.emplace(*s.names[i]);
+            auto& col = var.vals.back().second;
+            col.reserve(s.nbins);
+            for (size_t j=0; j<s.nbins; ++j) col.push_back(s.m[i*s.nbins+j]);
+          }
+        }
+        write_bin(out,bands,ivanp::dtos_shortest); // exact
+      } else emit_text(out,!strcmp(emit,"json"),pages,stack);
+    } catch (const std::exception& e) {
+      cerr << e << endl;
+      return 1;
+    }
+    return 0;
+  }
 
   TH1::AddDirectory(false);
 
-  TCanvas canv;
-  canv.SetMargin(std::get<0>(margins),std::get<1>(margins),
-                 std::get<2>(margins),std::get<3>(margins));
+  // bin labels replacing numbers, none if empty
+  const auto bin_labels = [](const std::string& name, const stack_t& s) {
+    std::vector<std::string> labels;
+    if (starts_with(name,"N_j_")) {
+      for (unsigned i=0; i<s.nbins; ++i)
+        labels.push_back(cat(
+          s.nbins-i>1 ? " = " : " #geq ", std::ceil(s.bins[i]) ));
+    } else if (name.substr(0,4)=="fid_") labels.resize(s.nbins);
+    return labels;
+  };
 
-  gPad->SetTickx();
-  gPad->SetTicky();
+  // native SVG, false if some text needs ROOT
+  auto render_svg = [&](const page_t& page, const stack_t& s,
+                        std::string fname) {
+    svg_page svg;
+    svg.margins = margins;
+    svg.bins.assign(s.bins.begin(),s.bins.end());
+    svg.bin_labels = bin_labels(page.name,s);
+    if (!svg.bin_labels.empty() && starts_with(page.name,"N_j_"))
+      svg.label_size = 0.08;
+    svg.xtitle = var_name(page.name);
+    svg.ytitle = ylabel;
+    svg.xoffset = 0.95;
+    svg.xtitle_size = 0.06;
+    svg.yoffset = yoffset;
+    svg.ytitle_size = 0.065;
+    svg.ymax = s.max;
+    svg.legend = { 0.14, 0.165, 0.92, 0.285 };
+    svg.legend_text_size = 0.041;
+
+    for (unsigned i=0, k=page.style; i<s.names.size(); ++i, ++k) {
+      if (k==styles.size()) k = 0u;
+      svg.bands.push_back({
+        i ? cat("#oplus ",unc_name(*s.names[i])) : unc_name(*s.names[i]),
+        svg_page::color(styles[k].fill_color),
+        svg_page::color(styles[k].line_color),
+        styles[k].line_style, s.m.data() + i*s.nbins });
+    }
+    svg.texts = {
+      { 0.15, 0.83, "ATLAS", 72, 0.05 },
+      { 0.27, 0.83, "Internal", 42, 0.05 },
+      { 0.15, 0.89,
+        "#it{H} #rightarrow #gamma#gamma, "
+        "#sqrt{#it{s}} = 13 TeV, 36.1 fb^{-1}, "
+        "m_{H} = 125.09 GeV", 42, 0.05 }
+    };
+
+    while (!fname.empty() && (fname.back()=='(' || fname.back()==')'))
+      fname.pop_back();
+    std::ostringstream out;
+    if (!svg.write(out)) return false;
+    std::ofstream f(fname);
+    if (!(f << out.str())) throw ivanp::error("cannot write ",fname);
+    return true;
+  };
 
-  if (!burst) ofname += '(';
-  bool first_page = true;
-  unsigned page_back_cnt = var_t::all.size();
-  // LOOP ===========================================================
-  for (const auto& var : var_t::all) {
-    --page_back_cnt;
-    cout << var.first << '\n';
+  // ================================================================
+  auto render = [&](const page_t& page, std::unique_ptr<TCanvas>& canv,
+                    const char* fname) {
+    const auto s = stack(page);
+    if (ext==".svg" && render_svg(page,s,fname)) return;
+    auto& c = canvas(canv);
+
+    const auto& name = page.name;
+    auto style = [&styles,i=page.style](TH1* h) mutable {
+      if (i==styles.size()) i = 0u;
+      h->SetFillColor(styles[i].fill_color);
+      h->SetLineColor(styles[i].line_color);
+      h->SetLineStyle(styles[i].line_style);
+      ++i;
+    };
 
-    const auto bins = var.second.bin_edges | ::stod;
-    const auto xsec = var.second.vals["xsec"] | ::stod;
-    const auto nbins = bins.size()-1;
-    const auto nbands = var.second.vals.size()-1;
+    const auto& bins = s.bins;
+    const auto nbins = s.nbins;
+    const auto nbands = s.names.size();
+    const auto& m = s.m;
 
     struct band {
       using type = TH1D;
@@ -178,26 +537,18 @@ int main(int argc, char* argv[]) {
     };
     std::vector<band> bands;
     bands.reserve(nbands);
-
-    // convert string to double and fill first histogram ------------
-    for (const auto& val : var.second.vals) {
-      if (val.first=="xsec") continue;
-
-      auto* h = new band::type("","",bins.size()-1,bins.data());
+    for (const auto* band_name : s.names) {
+      auto* h = new band::type("","",nbins,bins.data());
       h->SetStats(0);
       h->SetMarkerStyle(0);
       h->SetLineWidth(1); // gives legend color boxes outlines
       style(h);
-      bands.emplace_back(h,val.first);
-
-      auto* arr = bands.back().h1->GetArray() + 1;
-      // fill with squares to sum in quadrature
-      for (const auto& x : val.second) (*arr) = sq(::stod(x)), ++arr;
+      bands.emplace_back(h,*band_name);
     }
 
     TAxis *xa = bands.back().h1->GetXaxis(),
           *ya = bands.back().h1->GetYaxis();
-    xa->SetTitle(var_name(var.first).c_str());
+    xa->SetTitle(var_name(name).c_str());
     xa->SetTitleOffset(0.95);
     ya->SetTitleOffset(yoffset);
     ya->SetTitle(ylabel);
@@ -206,15 +557,14 @@ int main(int argc, char* argv[]) {
     ya->SetTitleSize(0.065);
     ya->SetLabelSize(0.05);
 
-    if (starts_with(var.first,"N_j_")) {
-      for (unsigned i=0; i<nbins; ++i) {
-        xa->SetBinLabel( i+1, cat(
-          nbins-i>1 ? " = " : " #geq ", std::ceil(bins[i])
-        ).c_str() );
+    { const auto labels = bin_labels(name,s);
+      if (starts_with(name,"N_j_")) {
+        for (unsigned i=0; i<nbins; ++i)
+          xa->SetBinLabel(i+1,labels[i].c_str());
+        xa->SetLabelSize(0.08);
+      } else if (!labels.empty()) {
+        xa->SetBinLabel(1,"");
       }
-      xa->SetLabelSize(0.08);
-    } else if (var.first.substr(0,4)=="fid_") {
-      xa->SetBinLabel(1,"");
     }
 
     TLegend leg(0.14, 0.165, 0.92, 0.285);
@@ -224,38 +574,20 @@ int main(int argc, char* argv[]) {
     leg.SetTextSize(0.041);
     leg.SetNColumns(2);
 
-    // sum and add to legend ----------------------------------------
-    leg.AddEntry(bands[0].h1,unc_name(*bands[0].name).c_str(),"f");
-    for (unsigned i=1; i<nbands; ++i) {
-      auto* arr1 = bands[i-1].h1->GetArray();
-      auto* arr2 = bands[i  ].h1->GetArray();
-      for (unsigned j=nbins; j; --j) arr2[j] += arr1[j];
+    // fill histograms and legend ----------------------------------
+    for (unsigned i=0; i<nbands; ++i) {
+      const double* row = m.data() + i*nbins;
+      auto* arr1 = bands[i].h1->GetArray() + 1;
+      auto* arr2 = bands[i].h2->GetArray() + 1;
+      for (unsigned j=0; j<nbins; ++j) arr2[j] = -(arr1[j] = row[j]);
       leg.AddEntry( // make legend entry
         bands[i].h1,
-        cat("#oplus ",unc_name(*bands[i].name)).c_str(),
+        (i ? cat("#oplus ",unc_name(*bands[i].name))
+           : unc_name(*bands[i].name)).c_str(),
         "f");
     }
 
-    // reflect, take sqrt, divide by xsec ---------------------------
-    for (const auto& b : bands) {
-      auto* arr1 = b.h1->GetArray();
-      auto* arr2 = b.h2->GetArray();
-      for (unsigned j=nbins; j; --j)
-        arr2[j] = -(arr1[j] = std::sqrt(arr1[j])/xsec[j-1]);
-    }
-
-    // set Y-range --------------------------------------------------
-    { double max = 0.;
-      const auto it = ranges.find(var.first);
-      if (it!=ranges.end()) max = it->second;
-      else {
-        auto* h = bands.back().h1;
-        const auto* arr = h->GetArray();
-        for (unsigned j=nbins; j; --j) larger(max,arr[j]);
-        max *= 1.65;
-      }
-      ya->SetRangeUser(-max,max);
-    }
+    ya->SetRangeUser(-s.max,s.max);
 
     // draw ---------------------------------------------------------
     for (auto it=bands.rbegin(), last=bands.rend(); it!=last; ++it) {
@@ -281,9 +613,263 @@ int main(int argc, char* argv[]) {
     );
     l.SetTextFont(42);
 
-    if (!burst && !page_back_cnt) ofname += ')';
-    canv.Print(ofname.c_str(),("Title:"+var.first).c_str());
-    if (!burst && first_page) ofname.pop_back(), first_page = false;
+    c.Print(fname,("Title:"+name).c_str());
+  };
+
+  if (!njobs) njobs = std::max(std::thread::hardware_concurrency(),1u);
+
+  if (njobs < 2 && !cache_dir) try { // LOOP ========================
+    if (!burst) ofname += '(';
+    bool first_page = true;
+    unsigned page_back_cnt = pages.size();
+    for (const auto& page : pages) {
+      --page_back_cnt;
+      cout << page.name << '\n';
+      if (!burst && !page_back_cnt) ofname += ')';
+      render(page,canv,
+        (burst ? burst_name(page.name) : ofname).c_str());
+      if (!burst && first_page) ofname.pop_back(), first_page = false;
+    }
+    return 0;
+  } catch (const std::exception& e) {
+    cerr << e << endl;
+    return 1;
   }
-  // ================================================================
+
+  // SINGLE PAGES ===================================================
+  // every page is rendered into its own file, then merged in order
+  const char* tmp_root = std::getenv("TMPDIR");
+  std::string tmp_dir = cat(tmp_root && *tmp_root ? tmp_root : "/tmp",
+                            "/plot.XXXXXX");
+  if (!burst && !cache_dir && !mkdtemp(&tmp_dir[0])) {
+    cerr << tc::red << "cannot create temporary directory" << tc::reset
+         << endl;
+    return 1;
+  }
+  if (cache_dir && ::mkdir(cache_dir,0777) && errno!=EEXIST) {
+    cerr << tc::red << "cannot create directory" << tc::reset << ' '
+         << cache_dir << endl;
+    return 1;
+  }
+  std::vector<std::string> fnames;
+  std::vector<size_t> todo; // pages to render
+  fnames.reserve(pages.size());
+  fnv1a stamp; // pages of another build of plot are not reused
+  struct stat exe;
+  if (cache_dir && !::stat("/proc/self/exe",&exe)) {
+    stamp(exe.st_size);
+    stamp(exe.st_mtim.tv_sec);
+    stamp(exe.st_mtim.tv_nsec);
+  }
+  for (const auto& page : pages) {
+    if (cache_dir) { // key on everything that goes on the page
+      fnv1a h = stamp;
+      h(ext); h(page.name); h(var_name(page.name));
+      h(ylabel); h(yoffset); h(margins);
+      const auto range = ranges.find(page.name);
+      if (range!=ranges.end()) h(range->second);
+      h(page.var.bin_edges.x);
+      unsigned i = page.style;
+      for (const auto& val : page.var.vals) {
+        h(val.first);
+        h(val.second.x); h(val.second.x2);
+        if (val.first=="xsec") continue;
+        if (i==styles.size()) i = 0u;
+        h(unc_name(val.first));
+        h(styles[i].fill_color);
+        h(styles[i].line_color);
+        h(styles[i].line_style);
+        ++i;
+      }
+      char hex[17];
+      snprintf(hex,sizeof(hex),"%016llx",(unsigned long long)h.value);
+      fnames.push_back(cat(cache_dir,'/',hex,ext));
+      // reused pages are touched, to be evicted last
+      if (::utimensat(AT_FDCWD,fnames.back().c_str(),nullptr,0))
+        todo.push_back(fnames.size()-1);
+    } else {
+      fnames.push_back( burst ? burst_name(page.name)
+                              : cat(tmp_dir,'/',fnames.size(),".pdf") );
+      todo.push_back(fnames.size()-1);
+    }
+  }
+
+  // cached pages are written under a temporary name first
+  auto render_to = [&](const page_t& page, std::unique_ptr<TCanvas>& canv,
+                       const std::string& fname) {
+    if (!cache_dir) return render(page,canv,fname.c_str());
+    const auto tmp = cat(fname.substr(0,fname.size()-ext.size()),
+                         ".part",getpid(),ext);
+    render(page,canv,tmp.c_str());
+    if (::rename(tmp.c_str(),fname.c_str())) throw ivanp::error(
+      "cannot rename ",tmp," to ",fname);
+  };
+
+  bool ok = true;
+  if (njobs > todo.size()) njobs = todo.size();
+  if (njobs < 2) try {
+    if (!todo.empty()) {
+      for (const size_t i : todo) render_to(pages[i],canv,fnames[i]);
+    }
+  } catch (const std::exception& e) {
+    cerr << e << endl;
+    ok = false;
+  } else { // each worker renders every njobs-th page
+    cout.flush();
+    cerr.flush();
+    std::vector<pid_t> workers;
+    for (unsigned k=0; k<njobs; ++k) {
+      const pid_t pid = fork();
+      if (pid==0) {
+        try {
+          for (size_t i=k; i<todo.size(); i+=njobs)
+            render_to(pages[todo[i]],canv,fnames[todo[i]]);
+        } catch (const std::exception& e) {
+          cerr << e << endl;
+          _exit(1);
+        }
+        _exit(0);
+      }
+      if (pid==-1) {
+        cerr << tc::red << "cannot fork" << tc::reset << endl;
+        break;
+      }
+      workers.push_back(pid);
+    }
+    ok = workers.size()==njobs;
+    for (const pid_t pid : workers) {
+      int status;
+      ok &= waitpid(pid,&status,0)==pid
+         && WIFEXITED(status) && WEXITSTATUS(status)==0;
+    }
+  }
+  if (ok) for (const auto& page : pages) cout << page.name << '\n';
+
+  if (!burst) {
+    if (ok && !merge_pdf(fnames,ofname)) {
+      cerr << tc::red << "cannot merge pages, need pdfunite or gs"
+           << tc::reset << endl;
+      ok = false;
+    }
+    if (!cache_dir) {
+      for (const auto& f : fnames) ::unlink(f.c_str());
+      ::rmdir(tmp_dir.c_str());
+    }
+  } else if (ok && cache_dir) {
+    for (size_t i=0; i<pages.size(); ++i) {
+      const auto fname = burst_name(pages[i].name);
+      std::ifstream src(fnames[i], std::ios::binary);
+      std::ofstream dst(fname, std::ios::binary);
+      if (!(dst << src.rdbuf())) {
+        cerr << tc::red << "cannot write" << tc::reset << ' '
+             << fname << endl;
+        ok = false;
+      }
+    }
+  }
+  if (cache_dir) prune_cache(cache_dir,uint64_t(cache_mb)<<20,fnames);
+  return !ok;
+}
+
+// Take jobs from plotc one at a time, keeping ROOT, the canvas
+// and parsed config files between them.
+// Interned names are never freed, so past a limit
+// the server runs itself afresh, with the same argv.
+int run_server(const std::string& path, std::unique_ptr<TCanvas>& canv,
+               char* argv[]) {
+  constexpr size_t max_interned = size_t(16)<<20;
+  namespace serve = ivanp::serve;
+  sockaddr_un addr;
+  const int sock = ::socket(AF_UNIX,SOCK_STREAM,0);
+  if (sock==-1 || !serve::address(path,addr)) {
+    cerr << tc::red << "cannot create socket" << tc::reset << ' '
+         << path << endl;
+    return 1;
+  }
+  if (!serve::socket_dir(path)) {
+    cerr << tc::red << "socket directory is not private" << tc::reset << ' '
+         << path << endl;
+    return 1;
+  }
+  ::unlink(path.c_str());
+  if (::bind(sock,reinterpret_cast<sockaddr*>(&addr),sizeof(addr))
+      || ::chmod(path.c_str(),0600) || ::listen(sock,16)) {
+    cerr << tc::red << "cannot listen on" << tc::reset << ' '
+         << path << endl;
+    return 1;
+  }
+  std::signal(SIGPIPE,SIG_IGN);
+  cerr << "listening on " << path << endl;
+
+  const int saved[2] = { ::dup(1), ::dup(2) };
+  const int home = ::open(".",O_RDONLY|O_DIRECTORY);
+  const auto flush = []{
+    cout.flush();
+    cerr.flush();
+    fflush(stdout);
+    fflush(stderr);
+  };
+  for (;;) {
+    const int conn = ::accept(sock,nullptr,nullptr);
+    if (conn==-1) {
+      if (errno==EINTR) continue;
+      break;
+    }
+    if (!serve::same_user(conn)) { // jobs run as this user
+      ::close(conn);
+      continue;
+    }
+    int fds[2] = { -1, -1 };
+    std::vector<std::string> args;
+    char status = 1;
+    if (serve::recv_request(conn,fds,args)) {
+      flush();
+      ::dup2(fds[0],1);
+      ::dup2(fds[1],2);
+      if (::chdir(args[0].c_str())) {
+        cerr << tc::red << "cannot enter directory" << tc::reset << ' '
+             << args[0] << endl;
+      } else {
+        std::vector<char*> argv;
+        for (auto it=args.begin()+1; it!=args.end(); ++it)
+          argv.push_back(&(*it)[0]);
+        argv.push_back(nullptr);
+        try {
+          status = run(argv.size()-1,argv.data(),canv);
+        } catch (const std::exception& e) {
+          cerr << e << endl;
+        }
+      }
+      flush();
+      ::dup2(saved[0],1);
+      ::dup2(saved[1],2);
+      if (::fchdir(home)) { }
+    }
+    for (const int fd : fds) if (fd!=-1) ::close(fd);
+    serve::write_all(conn,&status,1);
+    ::close(conn);
+
+    if (interned::pool_size() > max_interned) {
+      cerr << "restarting to free interned names" << endl;
+      for (const int fd : { sock, saved[0], saved[1], home }) ::close(fd);
+      ::execv("/proc/self/exe",argv);
+      cerr << tc::red << "cannot restart" << tc::reset << endl;
+      return 1;
+    }
+  }
+  return 1;
+}
+
+int main(int argc, char* argv[]) {
+  std::unique_ptr<TCanvas> canv;
+  if (argc>1 && !strcmp(argv[1],"--serve")) {
+    if (argc>3) {
+      cerr << tc::red << "--serve takes only the socket path" << tc::reset
+           << endl;
+      return 1;
+    }
+    return run_server(
+      argc>2 ? argv[2] : ivanp::serve::socket_path(),canv,argv);
+  }
+  return run(argc,argv,canv);
 }
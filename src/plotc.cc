@@ -0,0 +1,49 @@
+// Thin client for plot --serve, takes the same arguments as plot.
+// Runs plot directly if no server is listening.
+
+#include <iostream>
+#include <climits>
+
+#include "serve.hh"
+
+using std::cerr;
+using std::endl;
+namespace serve = ivanp::serve;
+
+int main(int argc, char* argv[]) {
+  sockaddr_un addr;
+  const int sock = ::socket(AF_UNIX,SOCK_STREAM,0);
+  if (sock!=-1 && serve::address(serve::socket_path(),addr) &&
+      !::connect(sock,reinterpret_cast<sockaddr*>(&addr),sizeof(addr))) {
+    if (!serve::same_user(sock)) {
+      cerr << "plot server is run by another user" << endl;
+      return 1;
+    }
+    char cwd[PATH_MAX];
+    if (!::getcwd(cwd,sizeof(cwd))) {
+      cerr << "cannot get working directory" << endl;
+      return 1;
+    }
+    std::vector<std::string> args { cwd, "plot" };
+    args.insert(args.end(),argv+1,argv+argc);
+    char status;
+    if (serve::send_request(sock,{1,2},args) && serve::read_all(sock,&status,1))
+      return status;
+    cerr << "lost connection to plot server" << endl;
+    return 1;
+  }
+
+  // plot from the same directory, or from PATH
+  char exe[PATH_MAX];
+  const ssize_t n = ::readlink("/proc/self/exe",exe,sizeof(exe)-1);
+  if (n>0) {
+    std::string plot(exe,n);
+    plot.replace(plot.rfind('/')+1,std::string::npos,"plot");
+    argv[0] = &plot[0];
+    ::execv(argv[0],argv);
+  }
+  argv[0] = const_cast<char*>("plot");
+  ::execvp(argv[0],argv);
+  cerr << "cannot run plot" << endl;
+  return 1;
+}
@@ -1,26 +1,132 @@
 #include "reader.hh"
+#include "binary.hh"
+#include "numconv.hh"
+
+#include <cstring>
+#include <unordered_set>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 
 using ivanp::error;
 
-var_t::all_t var_t::all;
+unsigned column::prec = 8;
+
+std::string column::format(double x, unsigned prec) {
+  char buf[ivanp::dtos_size];
+  const size_t len = ivanp::dtos(x,prec,buf,sizeof(buf));
+  if (len < sizeof(buf)) return { buf, len };
+  std::string str(len,'\0');
+  ivanp::dtos(x,prec,&str[0],len+1);
+  return str;
+}
+
+namespace {
+
+inline double parse(string_view s) noexcept {
+  double x;
+  return ivanp::stod(s,x) ? x : NAN;
+}
+
+// append the rest of the stream to str, a block at a time
+void read_rest(std::istream& in, std::string& str) {
+  char block[1<<16];
+  for (std::streamsize n;
+       (n = in.rdbuf()->sgetn(block,sizeof(block))) > 0; )
+    str.append(block,n);
+}
+
+}
+
+input_buffer::input_buffer(const char* fname) {
+  const int fd = ::open(fname,O_RDONLY);
+  if (fd==-1) throw error("cannot open file ",fname);
+  struct stat st;
+  if (::fstat(fd,&st)==-1) {
+    ::close(fd);
+    throw error("cannot stat file ",fname);
+  }
+  len = st.st_size;
+  if (len) {
+    map = ::mmap(nullptr,len,PROT_READ,MAP_PRIVATE,fd,0);
+    if (map==MAP_FAILED) {
+      map = nullptr;
+      ::close(fd);
+      throw error("cannot map file ",fname);
+    }
+    ::madvise(map,len,MADV_SEQUENTIAL);
+  }
+  ::close(fd);
+}
+input_buffer::input_buffer(std::istream& in) {
+  read_rest(in,str);
+  len = str.size();
+}
+input_buffer::~input_buffer() {
+  if (map) ::munmap(map,len);
+}
+
+void column::push_back(string_view s) {
+  const auto d = s.find(',');
+  if (d==string_view::npos) {
+    x.push_back(parse(s));
+    if (!x2.empty()) x2.push_back(NAN);
+  } else {
+    if (x2.empty()) x2.assign(x.size(),NAN);
+    const double a = parse(s.substr(0,d)), b = parse(s.substr(d+1));
+    // unparseable unless both halves are numbers
+    const bool ok = !std::isnan(a) && !std::isnan(b);
+    x .push_back(ok ? a : NAN);
+    x2.push_back(ok ? b : NAN);
+  }
+  text.push_back(s);
+}
+
+namespace {
 
-std::ostream& operator<<(std::ostream& out, const var_t::all_t& vars) {
+void write_text(std::ostream& out, const column& col, unsigned prec) {
+  char buf[ivanp::dtos_size];
+  for (size_t i=0, n=col.size(); i<n; ++i) {
+    out << ' ';
+    if (!col.text[i].empty()) out << col.text[i];
+    else {
+      const size_t len = ivanp::dtos(col.x[i],prec,buf,sizeof(buf));
+      if (len < sizeof(buf)) out.write(buf,len);
+      else out << column::format(col.x[i],prec);
+    }
+  }
+}
+
+void write_text(std::ostream& out, const dataset& vars, unsigned prec) {
   for (const auto& x : vars) {
     out << x.first << ".bins:";
-    for (const auto& b : x.second.bin_edges) out << ' ' << b;
+    write_text(out,x.second.bin_edges,prec);
     out << '\n';
     for (const auto& v : x.second.vals) {
       out << x.first << '.' << v.first << ':';
-      for (const auto& b : v.second) out << ' ' << b;
+      write_text(out,v.second,prec);
       out << '\n';
     }
     out << std::endl;
   }
+}
+
+}
+
+std::ostream& operator<<(std::ostream& out, const column& col) {
+  write_text(out,col,column::prec);
   return out;
 }
 
-void var_t::check() {
-  for (const auto& x : var_t::all) {
+std::ostream& operator<<(std::ostream& out, const dataset& vars) {
+  write_text(out,vars,column::prec);
+  return out;
+}
+
+void dataset::check() const {
+  for (const auto& x : *this) {
     if (x.second.bin_edges.empty()) throw error(
       "no bins for variable \"",x.first,'\"');
     const auto nbins = x.second.bin_edges.size()-1;
@@ -32,34 +138,148 @@ void var_t::check() {
   }
 }
 
-std::istream& operator>>(std::istream& in, var_t::all_t& vars) {
+void dataset::load(
+  const std::shared_ptr<const input_buffer>& buf, const var_filter& select
+) {
+  arena::scope scope; // for all variables read
+  if (is_binary(buf->view())) return read_bin(buf,*this,select);
+  auto data = buf->view();
   unsigned line_n = 0;
-  for (std::string line; std::getline(in,line); ) {
+  string_view prev_name;
+  var_t *x = nullptr;
+  bool skip = false;
+  for (string_view line; getline(data,line); ) {
+    ++line_n;
     if (std::all_of(line.begin(),line.end(),
           [](char c){ return std::isspace(c); })) continue;
     const auto d1 = line.find('.');
     const auto var_name = view(line,0,d1);
-    auto& x = vars[var_name];
+    if ((!x && !skip) || var_name!=prev_name) { // lines grouped by var
+      prev_name = var_name;
+      if (!(skip = select && !select(var_name))) x = &(*this)[var_name];
+    }
+    if (skip) continue;
     const auto d2 = line.find(':',d1+1);
     const auto field = view(line,d1+1,d2-d1-1);
-    std::vector<std::string> *v = nullptr;
+    column *v = nullptr;
     if (field=="bins") {
-      if (!x.bin_edges.empty()) throw error(
+      if (!x->bin_edges.empty()) throw error(
         "line ",line_n,": "
         "repeated binning for variable \"",var_name,'\"');
-      v = &x.bin_edges;
+      v = &x->bin_edges;
     } else {
-      if (!x.vals.emplace(field)) throw error(
+      if (!x->vals.emplace(field)) throw error(
         "line ",line_n,": "
         "repeated field \"",field,"\" in variable \"",var_name,'\"');
-      v = &x.vals.back().second;
+      v = &x->vals.back().second;
     }
-    auto chunk = view(line,d2+1);
-    for (;;) {
-      const auto head = peal_head(chunk);
-      if (!head) break;
-      v->emplace_back(head);
+    v->src = buf;
+    if (!x->bin_edges.empty()) v->reserve(x->bin_edges.size()-1);
+    const char *p = line.data() + d2 + 1, * const end = line.end();
+    for (;;) { // split on spaces and tabs
+      while (p!=end && (*p==' ' || *p=='\t')) ++p;
+      if (p==end) break;
+      const char* const head = p;
+      while (p!=end && *p!=' ' && *p!='\t') ++p;
+      v->push_back({head,size_t(p-head)});
     }
   }
+}
+
+void dataset::load(const char* fname, const var_filter& select) {
+  load(std::make_shared<const input_buffer>(fname),select);
+}
+
+void dataset::write(std::ostream& out, bool bin, unsigned prec) const {
+  if (bin) write_bin(out,*this,prec);
+  else write_text(out,*this,prec);
+}
+
+std::istream& operator>>(std::istream& in, dataset& vars) {
+  vars.load(std::make_shared<const input_buffer>(in));
   return in;
 }
+
+namespace {
+
+class text_stream : public var_stream {
+  std::unique_ptr<std::istream> file;
+  std::istream& in;
+  std::string buf, next_line;
+  size_t pos = 0;
+  std::unordered_set<std::string> done;
+
+  bool getline(string_view& line) {
+    for (;;) {
+      const auto nl = buf.find('\n',pos);
+      if (nl!=std::string::npos) {
+        line = view(buf,pos,nl-pos);
+        pos = nl+1;
+        return true;
+      }
+      if (!in) {
+        if (pos==buf.size()) return false;
+        line = view(buf,pos,buf.size()-pos);
+        pos = buf.size();
+        return true;
+      }
+      buf.erase(0,pos);
+      pos = 0;
+      const auto n = buf.size();
+      buf.resize(n + (1<<16));
+      in.read(&buf[n],1<<16);
+      buf.resize(n + in.gcount());
+    }
+  }
+
+public:
+  text_stream(std::unique_ptr<std::istream> f, std::istream& in, std::string b)
+  : file(std::move(f)), in(in), buf(std::move(b)) { }
+
+  bool next(dataset& vars) override {
+    vars.clear();
+    std::string block = std::move(next_line), name;
+    next_line.clear();
+    if (!block.empty()) name.assign(block,0,block.find('.'));
+    for (string_view line; getline(line); ) {
+      if (std::all_of(line.begin(),line.end(),
+            [](char c){ return std::isspace(c); })) continue;
+      const auto var_name = view(line,0,line.find('.'));
+      if (block.empty()) name.assign(var_name.data(),var_name.size());
+      else if (var_name!=name) {
+        next_line.assign(line.data(),line.size());
+        next_line += '\n';
+        break;
+      }
+      block.append(line.data(),line.size());
+      block += '\n';
+    }
+    if (block.empty()) return false;
+    if (!done.insert(name).second) throw error(
+      "lines of variable \"",name,"\" are not consecutive");
+    vars.load(std::make_shared<const input_buffer>(std::move(block)));
+    return true;
+  }
+};
+
+}
+
+std::unique_ptr<var_stream> var_stream::open(const char* fname) {
+  if (fname) { // binary files are mapped, text files are read in chunks
+    auto buf = std::make_shared<const input_buffer>(fname);
+    if (is_binary(buf->view()))
+      return std::make_unique<bin_stream>(std::move(buf));
+    buf.reset();
+    auto f = std::make_unique<std::ifstream>(fname);
+    if (!*f) throw error("cannot open file ",fname);
+    auto& in = *f;
+    return std::make_unique<text_stream>(std::move(f),in,std::string());
+  } else { // peek for the binary magic
+    std::string head(8,'\0');
+    std::cin.read(&head[0],head.size());
+    head.resize(std::cin.gcount());
+    if (is_binary(head))
+      return std::make_unique<bin_stream>(std::cin,std::move(head));
+    return std::make_unique<text_stream>(nullptr,std::cin,std::move(head));
+  }
+}
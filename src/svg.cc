@@ -0,0 +1,421 @@
+#include "svg.hh"
+
+#include <iostream>
+#include <sstream>
+#include <iomanip>
+#include <unordered_map>
+#include <algorithm>
+#include <cmath>
+#include <cctype>
+#include <cstdio>
+
+namespace {
+
+const std::unordered_map<std::string,const char*> symbols {
+  {"alpha","α"}, {"beta","β"}, {"gamma","γ"},
+  {"delta","δ"}, {"epsilon","ε"}, {"zeta","ζ"},
+  {"eta","η"}, {"theta","θ"}, {"iota","ι"},
+  {"kappa","κ"}, {"lambda","λ"}, {"mu","μ"},
+  {"nu","ν"}, {"xi","ξ"}, {"omicron","ο"},
+  {"pi","π"}, {"rho","ρ"}, {"sigma","σ"},
+  {"tau","τ"}, {"upsilon","υ"}, {"phi","φ"},
+  {"chi","χ"}, {"psi","ψ"}, {"omega","ω"},
+  {"Alpha","Α"}, {"Beta","Β"}, {"Gamma","Γ"},
+  {"Delta","Δ"}, {"Epsilon","Ε"}, {"Zeta","Ζ"},
+  {"Eta","Η"}, {"Theta","Θ"}, {"Iota","Ι"},
+  {"Kappa","Κ"}, {"Lambda","Λ"}, {"Mu","Μ"},
+  {"Nu","Ν"}, {"Xi","Ξ"}, {"Omicron","Ο"},
+  {"Pi","Π"}, {"Rho","Ρ"}, {"Sigma","Σ"},
+  {"Tau","Τ"}, {"Upsilon","Υ"}, {"Phi","Φ"},
+  {"Chi","Χ"}, {"Psi","Ψ"}, {"Omega","Ω"},
+  {"geq","≥"}, {"leq","≤"}, {"neq","≠"},
+  {"approx","≈"}, {"sim","∼"}, {"pm","±"},
+  {"times","×"}, {"cdot","⋅"}, {"oplus","⊕"},
+  {"otimes","⊗"}, {"infty","∞"}, {"circ","°"},
+  {"rightarrow","→"}, {"leftarrow","←"},
+  {"ell","ℓ"}, {"partial","∂"}
+};
+
+bool latex(const char*& p, const char* end, std::string& out, bool group) {
+  const auto arg = [&](const char* open) {
+    if (p==end || *p!='{') return false;
+    ++p;
+    out += open;
+    if (!latex(p,end,out,true)) return false;
+    out += "</tspan>";
+    return true;
+  };
+  while (p!=end) {
+    const char c = *p++;
+    switch (c) {
+      case '}': return group;
+      case '{': if (!latex(p,end,out,true)) return false; break;
+      case '_':
+        if (!arg("<tspan baseline-shift=\"sub\" font-size=\"70%\">"))
+          return false;
+        break;
+      case '^':
+        if (!arg("<tspan baseline-shift=\"super\" font-size=\"70%\">"))
+          return false;
+        break;
+      case '#': {
+        const char* const name = p;
+        while (p!=end && std::isalpha(*p)) ++p;
+        const std::string cmd(name,p);
+        if (cmd=="it") {
+          if (!arg("<tspan font-style=\"italic\">")) return false;
+        } else if (cmd=="bf") {
+          if (!arg("<tspan font-weight=\"bold\">")) return false;
+        } else if (cmd=="sqrt") {
+          if (!arg("√<tspan text-decoration=\"overline\">"))
+            return false;
+        } else {
+          const auto it = symbols.find(cmd);
+          if (it==symbols.end()) return false;
+          out += it->second;
+        }
+        break;
+      }
+      case '&': out += "&amp;"; break;
+      case '<': out += "&lt;"; break;
+      case '>': out += "&gt;"; break;
+      default: out += c;
+    }
+  }
+  return !group;
+}
+
+const char* font(short code) {
+  switch (code/10) {
+    case  1: return " font-family=\"Times,serif\" font-style=\"italic\"";
+    case  2: return " font-family=\"Times,serif\" font-weight=\"bold\"";
+    case  3: return " font-family=\"Times,serif\" font-weight=\"bold\" "
+                    "font-style=\"italic\"";
+    case  5: return " font-style=\"italic\"";
+    case  6: return " font-weight=\"bold\"";
+    case  7: return " font-weight=\"bold\" font-style=\"italic\"";
+    case  8: return " font-family=\"Courier,monospace\"";
+    case  9: return " font-family=\"Courier,monospace\" font-style=\"italic\"";
+    case 10: return " font-family=\"Courier,monospace\" font-weight=\"bold\"";
+    case 11: return " font-family=\"Courier,monospace\" font-weight=\"bold\" "
+                    "font-style=\"italic\"";
+    case 13: return " font-family=\"Times,serif\"";
+    default: return "";
+  }
+}
+
+const char* dashes(short style) {
+  switch (style) {
+    case 2: return " stroke-dasharray=\"8,6\"";
+    case 3: return " stroke-dasharray=\"2,4\"";
+    case 4: return " stroke-dasharray=\"8,4,2,4\"";
+    default: return "";
+  }
+}
+
+// ================================================================
+// ROOT's default colors, as set by TColor::InitializeColors
+
+float hls_value(float n1, float n2, float hue) {
+  if (hue > 360) hue -= 360;
+  if (hue < 0) hue += 360;
+  if (hue < 60) return n1 + (n2-n1)*hue/60;
+  if (hue < 180) return n2;
+  if (hue < 240) return n1 + (n2-n1)*(240-hue)/60;
+  return n1;
+}
+
+std::array<float,3> hls_to_rgb(float h, float l, float s) {
+  h = std::min(std::max(h,0.f),360.f);
+  l = std::min(std::max(l,0.f),1.f);
+  s = std::min(std::max(s,0.f),1.f);
+  if (!s) return { l, l, l };
+  const float m2 = l <= 0.5f ? l*(1+s) : l+s-l*s, m1 = 2*l-m2;
+  return { hls_value(m1,m2,h+120), hls_value(m1,m2,h),
+           hls_value(m1,m2,h-120) };
+}
+
+std::array<float,3> rgb_to_hls(float r, float g, float b) {
+  const float min = std::min({r,g,b}), max = std::max({r,g,b});
+  const float diff = max-min, sum = max+min, l = sum/2;
+  if (!diff) return { 0, l, 0 };
+  const float s = l < 0.5f ? diff/sum : diff/(2-sum);
+  const float rn = (max-r)/diff, gn = (max-g)/diff, bn = (max-b)/diff;
+  float h = r==max ? 60*(6+bn-gn) : g==max ? 60*(2+rn-bn) : 60*(4+gn-rn);
+  if (h > 360) h -= 360;
+  return { h, l, s };
+}
+
+std::unordered_map<short,svg_page::rgb> make_root_colors() {
+  std::unordered_map<short,svg_page::rgb> colors;
+  const auto set = [&](short i, float r, float g, float b) {
+    colors[i] = { (unsigned char)std::lround(r*255),
+                  (unsigned char)std::lround(g*255),
+                  (unsigned char)std::lround(b*255) };
+  };
+
+  static constexpr struct { short i; float r, g, b; } basic[] = {
+    { 0, 1, 1, 1 }, { 1, 0, 0, 0 }, { 2, 1, 0, 0 }, { 3, 0, 1, 0 },
+    { 4, 0, 0, 1 }, { 5, 1, 1, 0 }, { 6, 1, 0, 1 }, { 7, 0, 1, 1 },
+    { 8, .35, .83, .33 }, { 9, .35, .33, .85 },
+    { 10, .999, .999, .999 }, { 11, .754, .715, .676 },
+    { 12, .3, .3, .3 }, { 13, .4, .4, .4 }, { 14, .5, .5, .5 },
+    { 15, .6, .6, .6 }, { 16, .7, .7, .7 }, { 17, .8, .8, .8 },
+    { 18, .9, .9, .9 }, { 19, .95, .95, .95 },
+    { 20, .8, .78, .67 }, { 21, .8, .78, .67 }, { 22, .76, .75, .66 },
+    { 23, .73, .71, .64 }, { 24, .7, .65, .59 }, { 25, .72, .64, .61 },
+    { 26, .68, .6, .55 }, { 27, .61, .56, .51 }, { 28, .53, .4, .34 },
+    { 29, .69, .81, .78 }, { 30, .52, .76, .64 }, { 31, .54, .66, .63 },
+    { 32, .51, .62, .55 }, { 33, .68, .74, .78 }, { 34, .48, .56, .6 },
+    { 35, .46, .54, .57 }, { 36, .41, .51, .59 }, { 37, .43, .48, .52 },
+    { 38, .49, .6, .82 }, { 39, .5, .5, .61 }, { 40, .67, .65, .75 },
+    { 41, .83, .81, .53 }, { 42, .87, .73, .53 }, { 43, .74, .62, .51 },
+    { 44, .78, .6, .49 }, { 45, .75, .51, .47 }, { 46, .81, .37, .38 },
+    { 47, .67, .56, .58 }, { 48, .65, .47, .48 }, { 49, .58, .41, .44 },
+    { 50, .83, .35, .33 }, { 110, .999, .999, .999 }
+  };
+  for (const auto& c : basic) set(c.i,c.r,c.g,c.b);
+
+  // pretty palette, violet to red
+  for (int i=0; i<49; ++i) {
+    const auto c = hls_to_rgb(280-(i+1)*5.6f,0.5,1);
+    set(51+i,c[0],c[1],c[2]);
+  }
+
+  // shades of colors 1 to 7 for x3d
+  for (int i=1; i<8; ++i) {
+    std::array<float,3> c { basic[i].r, basic[i].g, basic[i].b };
+    if (i==1) c = { .6, .6, .6 };
+    for (auto& x : c) if (x==1) x = .9; else if (x==0) x = .1;
+    const auto hls = rgb_to_hls(c[0],c[1],c[2]);
+    const float f[] = { .6, .8, 1.2, 1.4 };
+    for (int k=0; k<4; ++k) {
+      c = hls_to_rgb(hls[0],f[k]*hls[1],hls[2]);
+      set(200+4*i-3+k,c[0],c[1],c[2]);
+    }
+  }
+
+  // color wheel: kColor-n to kColor+n, as web safe shades
+  const auto byte = [&](short i, const unsigned char* c) {
+    set(i,c[0]/255.f,c[1]/255.f,c[2]/255.f);
+  };
+  static constexpr unsigned char gray[] = { 0xcc, 0x99, 0x66, 0x33 };
+  for (int n=0; n<4; ++n) {
+    const unsigned char c[] = { gray[n], gray[n], gray[n] };
+    byte(920+n,c); // kGray
+  }
+
+  // primaries: full and other channels
+  static constexpr unsigned char circle[15][2] = {
+    {0xff,0xcc}, {0xff,0x99}, {0xcc,0x99}, {0xff,0x66}, {0xcc,0x66},
+    {0x99,0x66}, {0xff,0x33}, {0xcc,0x33}, {0x99,0x33}, {0x66,0x33},
+    {0xff,0x00}, {0xcc,0x00}, {0x99,0x00}, {0x66,0x00}, {0x33,0x00}
+  };
+  // magenta, red, yellow, green, cyan, blue
+  static constexpr struct { short i; bool r, g, b; } circles[] = {
+    { 616, 1, 0, 1 }, { 632, 1, 0, 0 }, { 400, 1, 1, 0 },
+    { 416, 0, 1, 0 }, { 432, 0, 1, 1 }, { 600, 0, 0, 1 }
+  };
+  for (const auto& w : circles)
+    for (int n=0; n<15; ++n) {
+      const auto* x = circle[n];
+      const unsigned char c[] = { x[!w.r], x[!w.g], x[!w.b] };
+      byte(w.i+n-10,c);
+    }
+
+  // mixtures: high, middle and low channels
+  static constexpr unsigned char rect[20][3] = {
+    {0xff,0xcc,0x99}, {0xff,0xcc,0x66}, {0xff,0x99,0x66}, {0xff,0xcc,0x33},
+    {0xff,0x99,0x33}, {0xff,0x66,0x33}, {0xcc,0x99,0x66}, {0xcc,0x99,0x33},
+    {0xcc,0x66,0x33}, {0xff,0xcc,0x00}, {0xff,0x99,0x00}, {0xcc,0x99,0x00},
+    {0x99,0x66,0x00}, {0x99,0x66,0x33}, {0xcc,0x66,0x00}, {0x99,0x33,0x00},
+    {0xff,0x66,0x00}, {0xcc,0x33,0x00}, {0x66,0x33,0x00}, {0xff,0x33,0x00}
+  };
+  // orange, spring, teal, azure, violet, pink
+  static constexpr struct { short i; unsigned char r, g, b; } rects[] = {
+    { 800, 0, 1, 2 }, { 820, 1, 0, 2 }, { 840, 2, 0, 1 },
+    { 860, 2, 1, 0 }, { 880, 1, 2, 0 }, { 900, 0, 2, 1 }
+  };
+  for (const auto& w : rects)
+    for (int n=0; n<20; ++n) {
+      const auto* x = rect[n];
+      const unsigned char c[] = { x[w.r], x[w.g], x[w.b] };
+      byte(w.i+n-9,c);
+    }
+
+  return colors;
+}
+
+std::ostream& operator<<(std::ostream& out, svg_page::rgb c) {
+  char buf[8];
+  snprintf(buf,sizeof(buf),"#%02x%02x%02x",c.r,c.g,c.b);
+  return out << buf;
+}
+
+// 1, 2 or 5 times a power of 10, for up to n divisions
+double tick_step(double range, int n) {
+  const double raw = range/n, e = std::pow(10.,std::floor(std::log10(raw)));
+  const double f = raw/e;
+  return (f<=1 ? 1 : f<=2 ? 2 : f<=5 ? 5 : 10)*e;
+}
+
+std::string tick_label(double x, double step) {
+  char buf[32];
+  snprintf(buf,sizeof(buf),"%g",std::round(x/step)*step + 0.);
+  return buf;
+}
+
+}
+
+bool svg_latex(string_view str, std::string& out) {
+  const char* p = str.data();
+  return latex(p,str.end(),out,false);
+}
+
+svg_page::rgb svg_page::color(short i) {
+  static const auto colors = make_root_colors();
+  const auto it = colors.find(i);
+  return it!=colors.end() ? it->second : rgb{ 0, 0, 0 };
+}
+
+bool svg_page::write(std::ostream& os) const {
+  std::string str;
+  const auto tex = [&str](const std::string& s) {
+    str.clear();
+    return svg_latex(s,str);
+  };
+
+  std::ostringstream out;
+  out << std::fixed << std::setprecision(2);
+  const double W = width, H = height;
+  const double x1 = margins[0]*W, x2 = (1-margins[1])*W,
+               y1 = margins[3]*H, y2 = (1-margins[2])*H;
+  const double xmin = bins.front(), xmax = bins.back();
+  // all zero bands still get a finite axis
+  const double ymax = this->ymax > 1e-6 ? this->ymax : 1e-6;
+  const auto X = [&](double x){ return x1 + (x-xmin)/(xmax-xmin)*(x2-x1); };
+  const auto Y = [&](double y){ return y2 - (y+ymax)/(2*ymax)*(y2-y1); };
+  const size_t nbins = bins.size()-1;
+
+  out << "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
+         "<svg xmlns=\"http://www.w3.org/2000/svg\""
+         " width=\"" << W << "\" height=\"" << H << "\""
+         " viewBox=\"0 0 " << W << ' ' << H << "\""
+         " font-family=\"Helvetica,Arial,sans-serif\">\n"
+         "<rect width=\"100%\" height=\"100%\" fill=\"#fff\"/>\n"
+         "<clipPath id=\"frame\"><rect x=\"" << x1 << "\" y=\"" << y1 <<
+         "\" width=\"" << x2-x1 << "\" height=\"" << y2-y1 <<
+         "\"/></clipPath>\n";
+
+  // bands ----------------------------------------------------------
+  out << "<g clip-path=\"url(#frame)\" stroke-width=\"1\">\n";
+  for (auto b=bands.rbegin(); b!=bands.rend(); ++b) {
+    for (const double sign : {1.,-1.}) {
+      std::ostringstream steps;
+      steps << std::fixed << std::setprecision(2);
+      for (size_t j=0; j<nbins; ++j) {
+        const double y = Y(sign*b->values[j]);
+        steps << " L" << X(bins[j]) << ',' << y << " L" << X(bins[j+1])
+              << ',' << y;
+      }
+      out << "<path fill=\"" << b->fill << "\" stroke=\"none\" d=\"M"
+          << X(xmin) << ',' << Y(0) << steps.str() << " L" << X(xmax) << ','
+          << Y(0) << " Z\"/>\n"
+          << "<path fill=\"none\" stroke=\"" << b->line << '\"'
+          << dashes(b->line_style) << " d=\"M" << X(xmin) << ',' << Y(0)
+          << steps.str() << " L" << X(xmax) << ',' << Y(0) << "\"/>\n";
+    }
+  }
+  out << "</g>\n";
+
+  // axes -----------------------------------------------------------
+  out << "<rect fill=\"none\" stroke=\"#000\" x=\"" << x1 << "\" y=\"" << y1
+      << "\" width=\"" << x2-x1 << "\" height=\"" << y2-y1 << "\"/>\n";
+  const double xtick = 0.03*(y2-y1), ytick = 0.03*(x2-x1);
+  out << "<path fill=\"none\" stroke=\"#000\" d=\"";
+  std::vector<std::pair<double,std::string>> xlabels, ylabels;
+  if (bin_labels.empty()) {
+    const double step = tick_step(xmax-xmin,10), minor = step/5;
+    for (long k=std::ceil(xmin/minor-1e-6); k*minor<=xmax+minor*1e-6; ++k) {
+      const double t = k*minor;
+      const bool major = k%5==0;
+      const double x = X(t), l = major ? xtick : xtick/2;
+      out << 'M' << x << ',' << y2 << " v" << -l
+          << " M" << x << ',' << y1 << " v" << l << ' ';
+      if (major) xlabels.emplace_back(x,tick_label(t,step));
+    }
+  } else {
+    for (size_t j=0; j<=nbins; ++j) {
+      const double x = X(bins[j]);
+      out << 'M' << x << ',' << y2 << " v" << -xtick
+          << " M" << x << ',' << y1 << " v" << xtick << ' ';
+      if (j<nbins && j<bin_labels.size())
+        xlabels.emplace_back((x+X(bins[j+1]))/2,bin_labels[j]);
+    }
+  }
+  { const double step = tick_step(2*ymax,10), minor = step/5;
+    for (long k=std::ceil(-ymax/minor-1e-6); k*minor<=ymax+minor*1e-6; ++k) {
+      const double t = k*minor;
+      const bool major = k%5==0;
+      const double y = Y(t), l = major ? ytick : ytick/2;
+      out << 'M' << x1 << ',' << y << " h" << l
+          << " M" << x2 << ',' << y << " h" << -l << ' ';
+      if (major) ylabels.emplace_back(y,tick_label(t,step));
+    }
+  }
+  out << "\"/>\n";
+
+  for (const auto& l : xlabels) {
+    if (!tex(l.second)) return false;
+    out << "<text text-anchor=\"middle\" font-size=\"" << label_size*H
+        << "\" x=\"" << l.first << "\" y=\"" << y2 + (0.005+label_size)*H
+        << "\">" << str << "</text>\n";
+  }
+  for (const auto& l : ylabels) {
+    if (!tex(l.second)) return false;
+    out << "<text text-anchor=\"end\" dominant-baseline=\"central\""
+           " font-size=\"" << 0.05*H << "\" x=\"" << x1 - 0.01*W
+        << "\" y=\"" << l.first << "\">" << str << "</text>\n";
+  }
+  if (!tex(xtitle)) return false;
+  out << "<text text-anchor=\"end\" font-size=\"" << xtitle_size*H
+      << "\" x=\"" << x2 << "\" y=\""
+      << y2 + xoffset*1.6*xtitle_size*H
+      << "\">" << str << "</text>\n";
+  if (!tex(ytitle)) return false;
+  { const double x = x1 - yoffset*1.6*ytitle_size*H;
+    out << "<text text-anchor=\"end\" font-size=\"" << ytitle_size*H
+        << "\" transform=\"translate(" << x << ',' << y1
+        << ") rotate(-90)\">" << str << "</text>\n";
+  }
+
+  // legend ---------------------------------------------------------
+  { const unsigned ncols = 2, nrows = (bands.size()+ncols-1)/ncols;
+    const double lx = legend[0]*W, ly = (1-legend[3])*H,
+                 cw = (legend[2]-legend[0])*W/ncols,
+                 rh = (legend[3]-legend[1])*H/std::max(nrows,1u),
+                 m = 0.25*cw;
+    for (size_t i=0; i<bands.size(); ++i) {
+      if (!tex(bands[i].label)) return false;
+      const double x = lx + (i%ncols)*cw, y = ly + (i/ncols + 0.5)*rh;
+      out << "<rect fill=\"" << bands[i].fill << "\" stroke=\""
+          << bands[i].line << '\"' << dashes(bands[i].line_style)
+          << " x=\"" << x + 0.15*m << "\" y=\"" << y - 0.35*rh
+          << "\" width=\"" << 0.7*m << "\" height=\"" << 0.7*rh << "\"/>\n"
+          << "<text dominant-baseline=\"central\" font-size=\""
+          << legend_text_size*H << "\" x=\"" << x + m << "\" y=\"" << y
+          << "\">" << str << "</text>\n";
+    }
+  }
+
+  for (const auto& t : texts) {
+    if (!tex(t.str)) return false;
+    out << "<text" << font(t.font) << " font-size=\"" << t.size*H
+        << "\" x=\"" << t.x*W << "\" y=\"" << (1-t.y)*H << "\">"
+        << str << "</text>\n";
+  }
+
+  out << "</svg>\n";
+  os << out.str();
+  return true;
+}